@@ -11,16 +11,627 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
-#include <stack>
 #include <cmath>
+#include <new>
+#include <type_traits>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <iterator>
+#include <utility>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
 
 using namespace std;
 
-template<typename KeyT, typename ValueT>
-class avlt
+//
+// avlt_new_alloc
+//
+// Node allocator policy that gives every node its own trip to the
+// heap: one "new" per insert and one "delete" per node on clear.
+// This is the original allocation path of avlt.
+//
+template<typename T>
+class avlt_new_alloc
+{
+public:
+  // true => release() frees every node at once, so clear() does not
+  // need to hand nodes back one at a time
+  static const bool releases_all = false;
+
+  T* allocate()
+  {
+    return static_cast<T*>(::operator new(sizeof(T)));
+  }
+
+  void deallocate(T* p)
+  {
+    ::operator delete(p);
+  }
+
+  void release()
+  {
+    // nothing is owned in bulk
+  }
+
+  void splice(avlt_new_alloc&)
+  {
+    // nodes are owned by the global heap, nothing to take over
+  }
+
+  void swap(avlt_new_alloc&)
+  {
+    // no state to exchange
+  }
+};
+
+//
+// avlt_pool
+//
+// Slab allocator policy: nodes are carved out of large contiguous
+// blocks, freed nodes are recycled through an intrusive free list, and
+// release() drops all the blocks at once.  Blocks start small and
+// double in size up to MaxBlockBytes so small trees stay small.
+//
+// Not thread-safe; each tree owns its own pool.
+//
+template<typename T>
+class avlt_pool
+{
+private:
+  union SLOT
+  {
+    SLOT* Next;  // link in free list when the slot is unused
+    alignas(T) unsigned char Storage[sizeof(T)];
+  };
+
+  struct BLOCK
+  {
+    BLOCK* Next;  // next block in the chain of blocks owned by the pool
+  };
+
+  static const size_t MinBlockNodes = 32;
+  static const size_t MaxBlockBytes = 64 * 1024;
+
+  // Slots start after the block header, rounded up to slot alignment
+  static const size_t HeaderBytes =
+    (sizeof(BLOCK) + alignof(SLOT) - 1) / alignof(SLOT) * alignof(SLOT);
+
+  BLOCK* Blocks;     // every block owned by the pool
+  SLOT*  FreeList;   // slots handed back through deallocate()
+  SLOT*  Bump;       // next never-used slot in the newest block
+  SLOT*  BumpEnd;    // one past the last slot in the newest block
+  size_t NextCount;  // # of slots in the next block to allocate
+
+	/* Allocates a new block and makes
+	 * it the source of fresh slots */
+	void _grow()
+	{
+		size_t bytes = HeaderBytes + NextCount * sizeof(SLOT);
+		BLOCK* block = static_cast<BLOCK*>(::operator new(bytes));
+
+		block->Next = Blocks;
+		Blocks = block;
+
+		Bump = reinterpret_cast<SLOT*>(reinterpret_cast<unsigned char*>(block) + HeaderBytes);
+		BumpEnd = Bump + NextCount;
+
+		/* Double the next block until it hits the size cap */
+		if((NextCount * 2) * sizeof(SLOT) <= MaxBlockBytes)
+			NextCount *= 2;
+	}
+
+public:
+  static const bool releases_all = true;
+
+  avlt_pool()
+    : Blocks(nullptr), FreeList(nullptr), Bump(nullptr), BumpEnd(nullptr),
+      NextCount(MinBlockNodes)
+  { }
+
+  // a pool owns raw memory for one tree, it is never shared
+  avlt_pool(const avlt_pool&) = delete;
+  avlt_pool& operator=(const avlt_pool&) = delete;
+
+  ~avlt_pool()
+  {
+    release();
+  }
+
+  T* allocate()
+  {
+    SLOT* slot;
+
+    if(FreeList != nullptr)  // Reuse a freed slot:
+    {
+      slot = FreeList;
+      FreeList = FreeList->Next;
+    }
+    else  // Carve a fresh slot, growing when the block is used up:
+    {
+      if(Bump == BumpEnd)
+        _grow();
+
+      slot = Bump;
+      Bump++;
+    }
+
+    return reinterpret_cast<T*>(slot->Storage);
+  }
+
+  void deallocate(T* p)
+  {
+    SLOT* slot = reinterpret_cast<SLOT*>(p);
+
+    slot->Next = FreeList;
+    FreeList = slot;
+  }
+
+  //
+  // splice:
+  //
+  // Takes over every block (and free slot) of the "other" pool, leaving
+  // it empty.  Nodes allocated from "other" are owned by this pool
+  // afterwards.
+  //
+  void splice(avlt_pool& other)
+  {
+    if(other.Blocks == nullptr)  // Nothing to take over
+      return;
+
+    /* Append our blocks behind the other's */
+    BLOCK* last = other.Blocks;
+    while(last->Next != nullptr)
+      last = last->Next;
+
+    last->Next = Blocks;
+    Blocks = other.Blocks;
+
+    /* Same for the free lists */
+    if(other.FreeList != nullptr)
+    {
+      SLOT* tail = other.FreeList;
+      while(tail->Next != nullptr)
+        tail = tail->Next;
+
+      tail->Next = FreeList;
+      FreeList = other.FreeList;
+    }
+
+    /* Unused slots at the end of the other's newest block are
+     * dropped; they are freed along with their block */
+    other.Blocks = nullptr;
+    other.FreeList = nullptr;
+    other.Bump = nullptr;
+    other.BumpEnd = nullptr;
+    other.NextCount = MinBlockNodes;
+  }
+
+  //
+  // swap:
+  //
+  // Exchanges the blocks and free slots of two pools, so the nodes of
+  // two trees can change hands without copying them.
+  //
+  void swap(avlt_pool& other)
+  {
+    std::swap(Blocks, other.Blocks);
+    std::swap(FreeList, other.FreeList);
+    std::swap(Bump, other.Bump);
+    std::swap(BumpEnd, other.BumpEnd);
+    std::swap(NextCount, other.NextCount);
+  }
+
+  //
+  // release:
+  //
+  // Frees every block at once.  Any object still living in the pool
+  // must already have been destroyed by the caller.
+  //
+  void release()
+  {
+    while(Blocks != nullptr)
+    {
+      BLOCK* next = Blocks->Next;
+      ::operator delete(Blocks);
+      Blocks = next;
+    }
+
+    FreeList = nullptr;
+    Bump = nullptr;
+    BumpEnd = nullptr;
+    NextCount = MinBlockNodes;
+  }
+};
+
+//
+// avlt_node_count
+//
+// Subtree size kept in every node when order statistics are enabled.
+// The disabled version is empty, and as a base class it takes no space
+// in the node.
+//
+template<bool Enabled>
+struct avlt_node_count
+{
+  int Count;  // # of nodes in the tree rooted at this node
+};
+
+template<>
+struct avlt_node_count<false>
+{
+};
+
+//
+// avlt_stats_snapshot
+//
+// Counters kept by a statistics policy, see avlt_stats.  Comparisons
+// are calls of the key comparator made to place a key: one per node
+// for a three-way comparator, one or two for a two-way one such as
+// std::less.  A path depth is the # of nodes a search or insert
+// looked at.
+//
+struct avlt_stats_snapshot
+{
+  // Depth histogram buckets; deeper paths are counted in the last one
+  static const int MaxDepth = 48;
+
+  uint64_t Searches;           // lookups by key: search, search_batch, [], %, find
+  uint64_t SearchComparisons;
+  uint64_t Inserts;            // insert, try_emplace, emplace, new or not
+  uint64_t InsertComparisons;
+  uint64_t Erases;
+  uint64_t EraseComparisons;
+  uint64_t SingleRotations;    // rebalances done with one rotation
+  uint64_t DoubleRotations;    // rebalances done with two
+  uint64_t RetraceSteps;       // nodes whose height was rechecked going up
+  uint64_t ThreadHops;         // threads followed by next() and range scans
+  uint64_t Allocations;        // nodes allocated
+  uint64_t Frees;              // nodes freed
+  uint64_t Depth[MaxDepth];    // Depth[d] = # of searches and inserts of depth d
+};
+
+//
+// avlt_no_stats
+//
+// Statistics policy that keeps nothing.  Every hook is empty, and as a
+// base class it takes no space, so the instrumented code paths compile
+// to exactly what they were without it.  This is the default.
+//
+struct avlt_no_stats
+{
+  void searched(int, int) const { }
+  void inserted(int, int) const { }
+  void erased(int, int) const { }
+  void rotated(bool) const { }
+  void retraced() const { }
+  void hopped() const { }
+  void allocated(uint64_t) const { }
+  void freed(uint64_t) const { }
+
+  avlt_stats_snapshot snapshot() const
+  {
+    return avlt_stats_snapshot{ };
+  }
+
+  void reset() const { }
+};
+
+//
+// avlt_stats
+//
+// Statistics policy that counts everything in avlt_stats_snapshot.
+// Costs a few increments per operation; the counters are plain
+// integers, so a tree using it must not be read by several threads at
+// once (even const reads count).  Supply your own policy with the same
+// hooks to keep per-thread or atomic counters instead.
+//
+class avlt_stats
+{
+private:
+  mutable avlt_stats_snapshot Counts;
+
+  static void _depth(avlt_stats_snapshot& c, int depth)
+  {
+    c.Depth[min(depth, avlt_stats_snapshot::MaxDepth - 1)]++;
+  }
+
+public:
+  avlt_stats() : Counts{ } { }
+
+  // A search that looked at depth nodes
+  void searched(int depth, int comparisons) const
+  {
+    Counts.Searches++;
+    Counts.SearchComparisons += comparisons;
+    _depth(Counts, depth);
+  }
+
+  // An insert that looked at depth nodes
+  void inserted(int depth, int comparisons) const
+  {
+    Counts.Inserts++;
+    Counts.InsertComparisons += comparisons;
+    _depth(Counts, depth);
+  }
+
+  void erased(int, int comparisons) const
+  {
+    Counts.Erases++;
+    Counts.EraseComparisons += comparisons;
+  }
+
+  void rotated(bool isDouble) const
+  {
+    if(isDouble)
+      Counts.DoubleRotations++;
+    else
+      Counts.SingleRotations++;
+  }
+
+  void retraced() const
+  {
+    Counts.RetraceSteps++;
+  }
+
+  void hopped() const
+  {
+    Counts.ThreadHops++;
+  }
+
+  void allocated(uint64_t n) const
+  {
+    Counts.Allocations += n;
+  }
+
+  void freed(uint64_t n) const
+  {
+    Counts.Frees += n;
+  }
+
+  avlt_stats_snapshot snapshot() const
+  {
+    return Counts;
+  }
+
+  void reset() const
+  {
+    Counts = avlt_stats_snapshot{ };
+  }
+};
+
+// Read-only flat copy made by avlt::freeze(), see frozen_avlt.h
+template<typename KeyT, typename ValueT, typename Compare>
+class frozen_avlt;
+
+//
+// avlt_codec
+//
+// How save() and load() turn keys and values into bytes and back.  The
+// default copies the object's bytes as is, so it only works for
+// trivially copyable types, and the image is only readable on machines
+// with the same byte order and type sizes.  For other types, specialize
+// avlt_codec or pass a codec class to save()/load() that provides:
+//
+//    static const size_t fixed_size;  // bytes per object, 0 => varies
+//    static void write(ostream& out, const T& x);
+//    static void read(istream& in, T& x);
+//
+// Images whose keys and values are all fixed size can also be mapped
+// into memory and searched in place; see avlt_image.h.
+//
+template<typename T>
+struct avlt_codec
+{
+  static_assert(is_trivially_copyable<T>::value,
+                "avlt_codec: give save()/load() a codec for this type");
+
+  static const size_t fixed_size = sizeof(T);
+
+  static void write(ostream& out, const T& x)
+  {
+    out.write(reinterpret_cast<const char*>(&x), sizeof(T));
+  }
+
+  static void read(istream& in, T& x)
+  {
+    in.read(reinterpret_cast<char*>(&x), sizeof(T));
+  }
+};
+
+// Strings are stored as a 32-bit length and then the characters
+template<>
+struct avlt_codec<string>
+{
+  static const size_t fixed_size = 0;
+
+  static void write(ostream& out, const string& x)
+  {
+    uint32_t length = (uint32_t)x.size();
+    out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.write(x.data(), length);
+  }
+
+  static void read(istream& in, string& x)
+  {
+    uint32_t length = 0;
+    in.read(reinterpret_cast<char*>(&length), sizeof(length));
+
+    if(!in)
+      return;
+
+    x.resize(length);
+    in.read(&x[0], length);
+  }
+};
+
+//
+// avlt_image_header
+//
+// First bytes of a file written by avlt::save().  With fixed-size keys
+// and values the pairs follow as two arrays in key order, keys first,
+// each starting on a 64-byte boundary; otherwise they follow as
+// (key, value) records in key order.
+//
+struct avlt_image_header
+{
+  char     Magic[4];      // "AVLT"
+  uint32_t Version;       // format version, currently 1
+  uint32_t KeyBytes;      // bytes per key, 0 => variable size records
+  uint32_t ValueBytes;    // bytes per value, 0 => variable size records
+  uint64_t Count;         // # of pairs
+  uint64_t KeysOffset;    // offset of the key array, or of the records
+  uint64_t ValuesOffset;  // offset of the value array, 0 for records
+
+  static const uint32_t CurrentVersion = 1;
+
+  /* Header for count pairs with the given encoded sizes */
+  static avlt_image_header make(size_t keyBytes, size_t valueBytes, uint64_t count)
+  {
+    avlt_image_header h = {{'A', 'V', 'L', 'T'}, CurrentVersion, (uint32_t)keyBytes,
+                           (uint32_t)valueBytes, count, 0, 0};
+
+    if(keyBytes == 0 || valueBytes == 0)  // Records right after the header
+    {
+      h.KeyBytes = 0;
+      h.ValueBytes = 0;
+      h.KeysOffset = sizeof(avlt_image_header);
+    }
+    else
+    {
+      h.KeysOffset = _align(sizeof(avlt_image_header));
+      h.ValuesOffset = _align(h.KeysOffset + count * keyBytes);
+    }
+
+    return h;
+  }
+
+  /* true => the magic and version are ours */
+  bool valid() const
+  {
+    return Magic[0] == 'A' && Magic[1] == 'V' && Magic[2] == 'L' && Magic[3] == 'T' &&
+           Version == CurrentVersion;
+  }
+
+  /* Rounds an offset up to the next 64-byte boundary */
+  static uint64_t _align(uint64_t offset)
+  {
+    return (offset + 63) / 64 * 64;
+  }
+};
+
+//
+// avlt_compare
+//
+// Default key comparison policy.  A comparison is three-way: negative,
+// zero or positive as a is less than, equal to or greater than b, so a
+// descent settles each node with one comparison.  Anything that converts
+// to a string_view (string, string_view, const char*) is compared with
+// one pass of string_view::compare, across types, so a tree of strings
+// can be searched with a string_view or a C string without building a
+// string; everything else goes through operator<.
+//
+// A comparator may instead be a two-way "less" that returns bool, like
+// std::less<> or std::greater<>; it then costs up to two calls per node.
+// One that declares is_transparent, like this one, also enables lookups
+// by any type it can compare with KeyT (see avlt::search).
+//
+template<typename A, typename B, typename = void>
+struct avlt_less_comparable : false_type
+{
+};
+
+template<typename A, typename B>
+struct avlt_less_comparable<A, B, void_t<decltype(declval<const A&>() < declval<const B&>()),
+                                         decltype(declval<const B&>() < declval<const A&>())>>
+  : true_type
+{
+};
+
+template<typename C, typename = void>
+struct avlt_transparent : false_type
+{
+};
+
+template<typename C>
+struct avlt_transparent<C, void_t<typename C::is_transparent>> : true_type
+{
+};
+
+struct avlt_compare
+{
+  using is_transparent = void;
+
+  template<typename A, typename B>
+  static constexpr bool isString = is_convertible<const A&, string_view>::value &&
+                                   is_convertible<const B&, string_view>::value;
+
+  template<typename A, typename B,
+           typename = enable_if_t<isString<A, B> || avlt_less_comparable<A, B>::value>>
+  int operator()(const A& a, const B& b) const
+  {
+    if constexpr (isString<A, B>)
+      return string_view(a).compare(string_view(b));
+    else
+      return (a < b) ? -1 : (b < a) ? 1 : 0;
+  }
+};
+
+//
+// avlt_less
+//
+// true if a comes before b under compare, which may be three-way, like
+// avlt_compare, or a two-way "less"; one call either way.  For the
+// classes that order keys like an avlt (frozen_avlt, avlt_image,
+// sharded_avlt).
+//
+template<typename Compare, typename A, typename B>
+bool avlt_less(const Compare& compare, const A& a, const B& b)
+{
+  if constexpr (is_same<decltype(compare(a, b)), bool>::value)
+    return compare(a, b);
+  else
+    return compare(a, b) < 0;
+}
+
+//
+// avlt
+//
+// NodeAlloc is the node allocator policy: a class template over the
+// node type providing allocate(), deallocate(), release(), splice(),
+// swap() and the releases_all flag (see avlt_new_alloc and avlt_pool
+// above).
+//
+// OrderStats => every node also stores the size of its subtree, which
+// gives rank(), select() and count_range() in O(lgN).  Off by default,
+// and then the nodes carry no extra field.
+//
+// Stats is the statistics policy: avlt_no_stats (the default, compiled
+// out) or avlt_stats, read back with stats() and reset_stats().
+//
+// Compare orders the keys: avlt_compare (the default) or any function
+// object taking two keys, see avlt_compare.  Keys are equal when
+// neither is less than the other; KeyT needs no operator==.  With a
+// transparent Compare, like the default, the lookups by key (search,
+// [], (), %, find, lower_bound, upper_bound, rank, count_range,
+// range_search and range_for_each) also take any key type it compares
+// with KeyT, e.g. a string_view or a C string for string keys, without
+// building a KeyT.
+//
+template<typename KeyT, typename ValueT, template<typename> class NodeAlloc = avlt_pool,
+         bool OrderStats = false, typename Stats = avlt_no_stats,
+         typename Compare = avlt_compare>
+class avlt : private Stats, private Compare
 {
 private:
-  struct NODE
+  typedef avlt_node_count<OrderStats> COUNT;
+
+  struct NODE : COUNT
   {
     KeyT   Key;
     ValueT Value;
@@ -30,403 +641,2577 @@ private:
     int    Height;     // height of tree rooted at this node
   };
 
+  // Largest height an AVL tree can reach while its size fits in an
+  // int: the sparsest AVL tree of height 44 already needs more than
+  // INT_MAX nodes.  A root-to-leaf path holds at most MaxHeight+1 nodes.
+  static const int MaxHeight = 43;
+
   NODE* Root;  // pointer to root node of tree (nullptr if empty)
   NODE* Current; // pointer to current node for begin and next functions
+  NODE* First; // leftmost node (nullptr if empty)
+  NODE* Last;  // rightmost node (nullptr if empty)
   int   Size;  // # of nodes in the tree (0 if empty)
+  NodeAlloc<NODE> Alloc; // hands out and takes back node memory
   
+  NODE* Spine[MaxHeight + 1]; // right spine, Root down to Last, for push_back
+  int   SpineTop;             // # of nodes in Spine, -1 => must be rebuilt
   
-	/* Traverse through the tree using 
-	 * postorder and free the nodes */
-	void _clear(NODE* cur)
+  NODE* Finger[MaxHeight + 1]; // search path of insert_hint's last key, Root first
+  int   FingerTop;             // # of nodes in Finger, 0 => none
+  
+  
+	/* The statistics policy, which every hook goes
+	 * through; its hooks are const so that const
+	 * functions like search can report too */
+	const Stats& _stats() const
 	{
-		if(cur == nullptr) // Tree is empty or tree 
-			return;        // has ended so return
+		return *this;
+	}
+	
+	
+	/* Three-way comparison of a and b with the Compare
+	 * policy; a two-way "less" is asked both ways */
+	template<typename A, typename B>
+	int _compare(const A& a, const B& b) const
+	{
+		const Compare& compare = *this;
+		
+		if constexpr (is_same<decltype(compare(a, b)), bool>::value)
+			return compare(a, b) ? -1 : compare(b, a) ? 1 : 0;
 		else
+			return compare(a, b);
+	}
+	
+	
+	/* The same comparison, adding to calls how many
+	 * times Compare was called: once for a three-way
+	 * Compare, once or twice for a two-way one */
+	template<typename A, typename B>
+	int _compare(const A& a, const B& b, int& calls) const
+	{
+		const Compare& compare = *this;
+		
+		calls++;
+		
+		if constexpr (is_same<decltype(compare(a, b)), bool>::value)
 		{
-			_clear(cur->Left); // Go Left
+			if(compare(a, b))
+				return -1;
 			
-			/* Go Right when it's not threaded */
-			if(!cur->isThreaded) 
+			calls++;
+			return compare(b, a) ? 1 : 0;
+		}
+		else
+			return compare(a, b);
+	}
+	
+	
+	/* true if a comes before b, 
+	 * with one call to Compare */
+	template<typename A, typename B>
+	bool _less(const A& a, const B& b) const
+	{
+		return avlt_less(static_cast<const Compare&>(*this), a, b);
+	}
+	
+	
+	/* Lets a lookup take a key of type K: KeyT itself, or
+	 * any type a transparent Compare compares with KeyT */
+	template<typename K>
+	using _lookup = enable_if_t<is_same<K, KeyT>::value ||
+	                            (avlt_transparent<Compare>::value &&
+	                             is_invocable<const Compare&, const K&, const KeyT&>::value &&
+	                             is_invocable<const Compare&, const KeyT&, const K&>::value), int>;
+	
+	
+	/* Allocates a node from the allocator policy and
+	 * fills in a new leaf, building the key and value
+	 * in place from the forwarded arguments */
+	template<typename K, typename... Args>
+	NODE* _newNode(K&& key, Args&&... args)
+	{
+		NODE* newNode = Alloc.allocate();
+		
+		try
+		{
+			new (newNode) NODE{COUNT(), KeyT(std::forward<K>(key)),
+			                   ValueT(std::forward<Args>(args)...), nullptr, nullptr, true, 0};
+		}
+		catch(...)  // Key or value copy threw, give the memory back:
+		{
+			Alloc.deallocate(newNode);
+			throw;
+		}
+		
+		if constexpr (OrderStats)
+			newNode->Count = 1;
+		
+		_stats().allocated(1);
+		return newNode;
+	}
+	
+	
+	/* Returns the # of nodes in the tree rooted at
+	 * cur (only kept when OrderStats is on) */
+	static int _count(const NODE* cur)
+	{
+		if constexpr (OrderStats)
+			return (cur == nullptr) ? 0 : cur->Count;
+		else
+			return 0;
+	}
+	
+	
+	/* Recomputes the subtree size of cur from its
+	 * children; does nothing without OrderStats */
+	static void _recount(NODE* cur)
+	{
+		if constexpr (OrderStats)
+			cur->Count = 1 + _count(cur->Left) + (cur->isThreaded ? 0 : _count(cur->Right));
+	}
+	
+	
+	/* Destroys a node and hands its
+	 * memory back to the allocator */
+	void _freeNode(NODE* cur)
+	{
+		cur->~NODE();
+		Alloc.deallocate(cur);
+		_stats().freed(1);
+	}
+	
+	
+	// Trees smaller than this are always copied on the calling thread
+	static const int ParallelCopyMin = 1 << 16;
+	
+	// # of lookups search_batch keeps in flight at once
+	static const int BatchLanes = 16;
+	
+	
+	/* Asks the CPU to start loading a node
+	 * into cache, where the compiler can */
+	static void _prefetch(const NODE* cur)
+	{
+#if defined(__GNUC__)
+		__builtin_prefetch(cur);
+#else
+		(void)cur;
+#endif
+	}
+	
+	
+	/* Free the nodes of the tree rooted at cur.  Uses an
+	 * explicit stack instead of recursion, and only treats
+	 * a non-threaded Right as a child, so it also works on a
+	 * partially copied tree whose threads are not set yet */
+	static void _clear(NODE* cur, NodeAlloc<NODE>& alloc)
+	{
+		NODE* nodes[MaxHeight + 2]; // Nodes waiting to be freed
+		int   top = 0;              // # of nodes on the stack
+		
+		if(cur == nullptr) // Tree is empty
+			return;
+		
+		nodes[top++] = cur;
+		
+		while(top > 0)
+		{
+			cur = nodes[--top];
+			
+			if(cur->Left != nullptr)  // Go Left later
+				nodes[top++] = cur->Left;
+			
+			/* Go Right later when it's not threaded */
+			if(!cur->isThreaded && cur->Right != nullptr)
+				nodes[top++] = cur->Right;
+			
+			/* The allocator drops its blocks wholesale 
+			 * afterwards, so only run the destructor */
+			cur->~NODE();
+			if(!NodeAlloc<NODE>::releases_all)
+				alloc.deallocate(cur); // Free node
+		}
+	}
+	
+	
+	/* Clones the subtree rooted at src, node for node, into
+	 * memory from alloc.  succ is the clone of the inorder
+	 * successor of the whole subtree, which the rightmost
+	 * clone threads to.  Heights are copied, so there are no
+	 * searches and no rotations: O(N) with no recursion. */
+	static NODE* _clone(const NODE* src, NODE* succ, NodeAlloc<NODE>& alloc)
+	{
+		struct ITEM
+		{
+			const NODE* Src;  // Node to copy the children of
+			NODE*       Dst;  // Its clone
+			NODE*       Succ; // Clone of the inorder successor of Src's subtree
+		};
+		
+		ITEM  items[MaxHeight + 2]; // Clones whose children are not copied yet
+		int   top = 0;              // # of items on the stack
+		NODE* root = nullptr;       // Clone of src
+		
+		if(src == nullptr) // Tree is empty
+			return nullptr;
+		
+		try
+		{
+			root = _cloneNode(src, succ, alloc);
+			items[top++] = ITEM{src, root, succ};
+			
+			while(top > 0)
+			{
+				ITEM item = items[--top];
+				
+				/* Right first so the left subtree is copied first */
+				if(!item.Src->isThreaded)
+				{
+					NODE* right = _cloneNode(item.Src->Right, item.Succ, alloc);
+					item.Dst->Right = right;
+					item.Dst->isThreaded = false;
+					items[top++] = ITEM{item.Src->Right, right, item.Succ};
+				}
+				
+				/* The left subtree's successor is the node itself */
+				if(item.Src->Left != nullptr)
+				{
+					NODE* left = _cloneNode(item.Src->Left, item.Dst, alloc);
+					item.Dst->Left = left;
+					items[top++] = ITEM{item.Src->Left, left, item.Dst};
+				}
+			}
+		}
+		catch(...)  // Key or value copy threw, free the partial copy:
+		{
+			_clear(root, alloc);
+			throw;
+		}
+		
+		return root;
+	}
+	
+	
+	/* Copies one node, threaded to succ until
+	 * a right child is attached to it */
+	static NODE* _cloneNode(const NODE* src, NODE* succ, NodeAlloc<NODE>& alloc)
+	{
+		NODE* newNode = alloc.allocate();
+		
+		try
+		{
+			new (newNode) NODE{static_cast<const COUNT&>(*src), src->Key, src->Value,
+			                   nullptr, succ, true, src->Height};
+		}
+		catch(...)  // Key or value copy threw, give the memory back:
+		{
+			alloc.deallocate(newNode);
+			throw;
+		}
+		
+		return newNode;
+	}
+	
+	
+	/* Makes this (empty) tree an exact copy of the other
+	 * tree.  With threads > 1 and a large enough tree, the
+	 * top levels are copied here and the subtrees below
+	 * them are cloned by worker threads, each into its own
+	 * allocator that is spliced into ours afterwards. */
+	void _copy(const avlt& other, int threads)
+	{
+		if(threads <= 1 || other.Size < ParallelCopyMin)
+		{
+			Root = _clone(other.Root, nullptr, Alloc);
+			Size = other.Size;
+			_stats().allocated(Size);
+			_ends();
+			return;
+		}
+		
+		struct TASK
+		{
+			const NODE* Src;    // Subtree to clone
+			NODE*       Parent; // Clone that the subtree hangs off
+			bool        isLeft; // true => hangs off Parent->Left
+			NODE*       Succ;   // Clone of the subtree's inorder successor
+			NODE*       Result; // Clone made by the worker
+		};
+		
+		struct ITEM
+		{
+			const NODE* Src;
+			NODE*       Dst;
+			NODE*       Succ;
+			int         Depth;
+		};
+		
+		/* Split at the first level with at least one subtree per thread */
+		int splitDepth = 0;
+		while((1 << splitDepth) < threads)
+			splitDepth++;
+		
+		vector<TASK> tasks;
+		ITEM items[MaxHeight + 2];
+		int  top = 0;
+		
+		/* Copy the levels above the split here, and record the
+		 * subtrees hanging below them as tasks */
+		Root = _cloneNode(other.Root, nullptr, Alloc);
+		Size = other.Size;
+		items[top++] = ITEM{other.Root, Root, nullptr, 0};
+		
+		try
+		{
+			while(top > 0)
+			{
+				ITEM item = items[--top];
+				
+				if(!item.Src->isThreaded)
+				{
+					if(item.Depth + 1 == splitDepth)
+						tasks.push_back(TASK{item.Src->Right, item.Dst, false, item.Succ, nullptr});
+					else
+					{
+						NODE* right = _cloneNode(item.Src->Right, item.Succ, Alloc);
+						item.Dst->Right = right;
+						item.Dst->isThreaded = false;
+						items[top++] = ITEM{item.Src->Right, right, item.Succ, item.Depth + 1};
+					}
+				}
+				
+				if(item.Src->Left != nullptr)
+				{
+					if(item.Depth + 1 == splitDepth)
+						tasks.push_back(TASK{item.Src->Left, item.Dst, true, item.Dst, nullptr});
+					else
+					{
+						NODE* left = _cloneNode(item.Src->Left, item.Dst, Alloc);
+						item.Dst->Left = left;
+						items[top++] = ITEM{item.Src->Left, left, item.Dst, item.Depth + 1};
+					}
+				}
+			}
+		}
+		catch(...)  // Copy threw, free the partial copy:
+		{
+			clear();
+			throw;
+		}
+		
+		/* Hand the tasks out round robin, each worker owning an allocator */
+		int workers = min(threads, (int)tasks.size());
+		unique_ptr<NodeAlloc<NODE>[]> allocs(new NodeAlloc<NODE>[workers]);
+		vector<exception_ptr> errors(workers);
+		vector<thread> pool;
+		
+		auto work = [&](int w)
+		{
+			try
+			{
+				for(size_t t = w; t < tasks.size(); t += workers)
+					tasks[t].Result = _clone(tasks[t].Src, tasks[t].Succ, allocs[w]);
+			}
+			catch(...)
+			{
+				errors[w] = current_exception();
+			}
+		};
+		
+		for(int w = 1; w < workers; w++)
+			pool.push_back(thread(work, w));
+		
+		if(workers > 0)
+			work(0);  // The calling thread is worker 0
+		
+		for(thread& t : pool)
+			t.join();
+		
+		/* Take over the workers' memory and attach their subtrees */
+		for(int w = 0; w < workers; w++)
+			Alloc.splice(allocs[w]);
+		
+		for(TASK& task : tasks)
+		{
+			if(task.Result == nullptr)  // Worker failed, leave the thread
+				continue;
+			
+			if(task.isLeft)
+				task.Parent->Left = task.Result;
+			else
+			{
+				task.Parent->Right = task.Result;
+				task.Parent->isThreaded = false;
+			}
+		}
+		
+		for(exception_ptr& error : errors)
+		{
+			if(error)
+			{
+				clear();
+				rethrow_exception(error);
+			}
+		}
+		
+		_stats().allocated(Size);
+		_ends();
+	}
+	
+	
+	/* Traverse through the tree using 
+	 * inorder and print the nodes */
+	void _print(NODE* cur, ostream& output)const
+	{
+		if(cur == nullptr) // Tree is empty or tree
+			return;        // has ended so return
+		else
+		{
+			_print(cur->Left, output); // Go Left
+			
+			/* Print (Key, Value, Height, Thread) when node is threaded
+			 * and there is a node right of the current node.*/
+			if(cur->isThreaded && cur->Right != nullptr)
+			{
+				output << "(" << cur->Key << "," << cur->Value << ","
+				<< cur->Height << "," << cur->Right->Key << ")"<< endl;
+			}
+			else
+			{
+				/* Print (Key, Value, Height) when node is not 
+				 * threaded and go right to the next node */
+				output << "(" << cur->Key << "," << cur->Value
+				       << "," << cur->Height<< ")"<< endl;
+				_print(cur->Right, output); // Go Right
+			}
+				
+		}
+	}
+	
+	
+	/* This function rotates the tree
+	 * to the left when it's broken
+	 * and updates the height */
+	void _LeftRotate(NODE* Parent, NODE* N)
+	{
+		NODE* A = N->Left;        // 100   N      
+		NODE* R = N->Right;       //  
+		NODE* B = R->Left;        //     110   R
+		NODE* C = R->Right;       // 
+		                          //         120   C
+    
+		// Unlink threading for rotation:
+		if(R->isThreaded)
+		{
+			C = nullptr;
+		}
+		
+		// Make left rotation:
+	    R->Left = N;
+		N->Right = B;
+		
+		// Rethread after rotation:
+		if(B == nullptr)
+		{
+			N->Right = R;
+			N->isThreaded = true;
+		}
+		
+		// Check if N has a parent: 
+		if(Parent == nullptr)
+		{
+			Root = R;  // No parent, so R becomes root
+		}
+		else if(Parent->Left == N)
+		{
+			Parent->Left = R;  // Relink Parent's left pointer
+		}
+		else
+		{
+			Parent->Right = R;  // Relink Parent's right pointer
+		}
+     
+		int HA;  // Height of A
+		int HB;  // Height of B 
+		int HC;  // Height of C
+     
+		if(A == nullptr)  // No node, make height -1:
+		{
+			HA = -1;
+		}
+		else  // Node exists, get height:
+		{
+			HA = A->Height;
+		}
+     
+		if(B == nullptr)  // No node, make height -1:
+		{ 
+			HB = -1;
+		}
+		else  // Node exists, get height:
+		{
+			HB = B->Height;
+		}
+     
+		if(C == nullptr)  // No node, make height -1:
+		{
+			HC = -1;
+		}
+		else  // Node exists, get height:
+		{
+			HC = C->Height;
+		}
+     
+		 N->Height = 1 + max(HA, HB);        // Update height of N
+		 R->Height = 1 + max(HC, N->Height); // Update height of R
+		 
+		 _recount(N);  // Update subtree sizes, N first
+		 _recount(R);  // since it's now below R
+     }
+	 
+	 
+	 /* This function rotates the tree
+	  * to the right when it's broken
+	  * and updates the height */
+	 void _RightRotate(NODE* Parent, NODE* N)
+	 {
+		 NODE* L = N->Left;        //            3   N      
+		 NODE* A = L->Left;        //
+		 NODE* B = L->Right;       //        2    L
+		 NODE* C = N->Right;       //
+                                   //    1     A
+		                           //
+		 
+		 // Unlink threading for rotation:
+	     if(L->isThreaded)
+		 {
+			B = nullptr;
+		 }
+		 if(N->isThreaded)
+		 {
+			C = nullptr;
+		 }
+		 
+		 // Make right rotation and unthread:
+		 L->Right = N;
+		 L->isThreaded = false;
+		 N->Left = B;
+		 
+		 // Check if N has a parent:
+		 if(Parent == nullptr)
+		 {
+			 Root = L;  // No parent, so L becomes root
+		 }
+		 else if(Parent->Left == N)
+		 {
+			 Parent->Left = L;  // Relink Parent's left pointer
+         }
+		 else 
+		 {
+			 Parent->Right = L;  // Relink Parent's right pointer
+		 }
+		 
+		 int HA;  // Height of A
+		 int HB;  // Height of B
+		 int HC;  // Height of C
+      
+		 if(A == nullptr)  // No node, make height -1:
+		 {
+			HA = -1; 
+		 }
+		 else  // Node exists, get height:
+		 {
+			HA = A->Height;
+		 }
+      
+		 if(B == nullptr)  // No node, make height -1:
+		 {
+			HB = -1; 
+		 }
+		 else  // Node exists, get height:
+		 {
+			HB = B->Height;
+		 }
+      
+		 if(C == nullptr)  // No node, make height -1:
+		 {
+			HC = -1; 
+		 }
+		 else  // Node exists, get height:
+		 {
+			HC = C->Height;
+		 }
+      
+		 N->Height = 1 + max(HB, HC);        // Update height of N
+		 L->Height = 1 + max(HA, N->Height); // Update height of L
+		 
+		 _recount(N);  // Update subtree sizes, N first
+		 _recount(L);  // since it's now below L
+	  }
+	
+	
+	/* Walks back up a search path (root first, count
+	 * nodes), updating heights and rotating wherever
+	 * the tree is broken.  Stops as soon as a subtree
+	 * keeps the height it had, since nothing above it
+	 * can change.  Used after insertion and deletion.
+	 * The path is a fixed-size array since its length
+	 * is bounded by MaxHeight.  Returns the # of path
+	 * nodes, from the root, still on a path after any
+	 * rotations (count if nothing was rotated). */
+	int _rebalance(NODE* path[], int count)
+	{
+		int valid = count;  // Path nodes above the highest rotation
+		
+		for(int i = count - 1; i >= 0; i--)
+		{
+			NODE* cur = path[i];                               // Current node
+			NODE* parent = (i == 0) ? nullptr : path[i - 1];  // Parent of the current node
+			
+			_stats().retraced();
+			
+			/* Get the left and right heights and of the node and calculate total height */
+			int hL = (cur->Left == nullptr) ? -1 : cur->Left->Height;
+			int hR = (cur->Right == nullptr || cur->isThreaded) ? -1 : cur->Right->Height;
+			int hCur = 1 + max(hL, hR);
+			
+			if(abs(hL - hR) <= 1)  // Balanced:
+			{
+				if(cur->Height == hCur)  // didn't change, so no need to go further:
+					break;
+				
+				cur->Height = hCur;  // height changed, update and keep going
+				continue;
+			}
+			
+			int  oldHeight = cur->Height;  // Height before the update
+			bool isLeft = (parent != nullptr && parent->Left == cur);
+			
+			valid = i;  // cur moves down, the path is broken from here
+			
+			if(hL > hR)  // Check if cur->Left is leaning:
+			{
+				NODE* L = cur->Left;  // Get left node of current
+				
+				/* Get the left and right heights of L */
+				int hLL = (L->Left == nullptr) ? -1 : L->Left->Height;
+				int hLR = (L->Right == nullptr || L->isThreaded) ? -1 : L->Right->Height;
+				
+				if(hLL >= hLR) // Case 1
+				{
+					_RightRotate(parent, cur);
+				}
+				else // Case 2
+				{
+					_LeftRotate(cur, cur->Left);  // Rotate left
+					_RightRotate(parent, cur);    // Rotate right
+				}
+				
+				_stats().rotated(hLL < hLR);
+			}
+			else  // cur->Right is leaning:
+			{
+				NODE* R = cur->Right;  // Get right node of current
+				
+				/* Get the left and right heights of R */
+				int hRR = (R->Right == nullptr || R->isThreaded) ? -1 : R->Right->Height;
+				int hRL = (R->Left == nullptr) ? -1 : R->Left->Height;
+				
+				if(hRR >= hRL) // Case 4
+				{
+					_LeftRotate(parent, cur);  // Rotate left
+				}
+				else // Case 3
+				{
+					_RightRotate(cur, cur->Right);  // Rotate right
+					_LeftRotate(parent, cur);       // Rotate left
+				}
+				
+				_stats().rotated(hRR < hRL);
+			}
+			
+			/* Find the new root of this subtree */
+			NODE* sub;
+			if(parent == nullptr)
+				sub = Root;
+			else if(isLeft)
+				sub = parent->Left;
+			else
+				sub = parent->Right;
+			
+			if(sub->Height == oldHeight)  // Same height as before, done:
+				break;
+		}
+		
+		return valid;
+	}
+	
+	
+	/* Returns the node that contains key,
+	 * or nullptr if key is not in the tree */
+	template<typename K>
+	NODE* _find(const K& key) const
+	{
+		NODE* cur = Root;      // Current Node
+		int   depth = 0;       // # of nodes looked at, for the stats
+		int   comparisons = 0; // # of calls of Compare, for the stats
+		
+		/* Loop through the tree */
+		while (cur != nullptr)
+		{
+			depth++;
+			
+			int order = _compare(key, cur->Key, comparisons);
+			
+			if (order == 0)  // Key found
+			{
+				_stats().searched(depth, comparisons);
+				return cur;
+			}
+			
+			/* Check if key is less than current key */
+			if (order < 0)
+			{
+				cur = cur->Left; // Move left
+			}
+			/* Check if key is greater than current key */
+			else if (cur->isThreaded)
+			{
+				cur = nullptr;
+			}
+			else
+			{
+				cur = cur->Right; // Move Right
+			}
+		}
+		
+		_stats().searched(depth, comparisons);
+		return nullptr;
+	}
+	
+	
+	/* Searches for key, pushing every node visited
+	 * before it onto path.  Returns the node holding
+	 * key, or nullptr if key is not in the tree; then
+	 * prev is the node where we fell out of the tree.
+	 * Adds the calls of Compare made to comparisons. */
+	NODE* _searchPath(const KeyT& key, NODE* path[], int& top, NODE*& prev, int& comparisons) const
+	{
+		NODE* cur = Root; // Current Node
+		prev = nullptr;   // Previous Node
+		
+		/* Search to see if tree already contains key */
+		while (cur != nullptr)
+		{
+			int order = _compare(key, cur->Key, comparisons);
+			
+			if (order == 0)  // Key already in tree
+				return cur;
+			
+			path[top++] = cur; // stack so we can return later
+			prev = cur;
+			
+			if (order < 0)  // Search left
+			{
+				cur = cur->Left;
+			}
+			else if (cur->isThreaded)  // Nothing to the right
+			{
+				cur = nullptr;
+			}
+			else // Not Threaded
+			{
+				cur = cur->Right; // Move right
+			}
+		}
+		
+		return nullptr;
+	}
+	
+	
+	/* Links a new leaf below prev, the node where
+	 * _searchPath fell out of the tree, then walks
+	 * back up the path to update heights and rotate.
+	 * Returns what _rebalance returns. */
+	int _link(NODE* newNode, NODE* prev, NODE* path[], int top)
+	{
+		//
+		// NOTE: if prev is null, then the tree is empty 
+		// and the Root pointer needs to be updated.
+		//
+		
+		if(prev == nullptr)
+		{
+			Root = newNode;
+			First = newNode;
+			Last = newNode;
+		}
+		else if (_less(newNode->Key, prev->Key))
+		{
+			prev->Left = newNode;  // Insert new node to the left of the previous
+			newNode->Right = prev; // Point new node's right pointer 
+			                       // to the node on the right
+			
+			if(prev == First)  // New leftmost node
+				First = newNode;
+		}
+		else
+		{
+			newNode->Right = prev->Right;
+			prev->isThreaded = false;
+			prev->Right = newNode; // Insert new node to the right of the previous
+			
+			if(prev == Last)  // New rightmost node
+				Last = newNode;
+		}
+		
+		Size++; // Update Size
+		SpineTop = -1;  // Rotations may move the right spine
+		FingerTop = 0;  // and the path insert_hint kept
+		
+		/* Every node on the path gained one descendant; done
+		 * before rebalancing, which may stop early */
+		if constexpr (OrderStats)
+		{
+			for(int i = 0; i < top; i++)
+				path[i]->Count++;
+		}
+		
+		// Walk back up tree using stack, update heights and rotate:
+		return _rebalance(path, top);
+	}
+	
+	
+	/* Inserts a new node holding key and a value built
+	 * from args, unless key is already in the tree.
+	 * The value is only constructed once we know the
+	 * key is new. */
+	template<typename K, typename... Args>
+	bool _tryEmplace(K&& key, Args&&... args)
+	{
+		NODE* path[MaxHeight + 1]; // Path of nodes to check heights, fixed size
+		int   top = 0;             // so inserting never touches the heap
+		NODE* prev;                // Node where we fell out of the tree
+		int   comparisons = 0;     // # of calls of Compare, for the stats
+		
+		bool found = (_searchPath(key, path, top, prev, comparisons) != nullptr);
+		
+		_stats().inserted(top + found, comparisons);
+		
+		if(found)  // Key already in tree
+			return false;
+		
+		/* Key is not in tree, so a new 
+		 * node is allocated to insert */
+		_link(_newNode(std::forward<K>(key), std::forward<Args>(args)...), prev, path, top);
+		return true;
+	}
+	
+	
+	/* Finds the leftmost and rightmost nodes again
+	 * after the tree was rebuilt or copied wholesale */
+	void _ends()
+	{
+		First = _begin(Root);
+		Last = Root;
+		SpineTop = -1;
+		FingerTop = 0;
+		
+		/* Follow real right children down to the rightmost node */
+		while(Last != nullptr && !Last->isThreaded)
+			Last = Last->Right;
+	}
+	
+	
+	/* Refills Spine with the right spine of the tree, from
+	 * Root down to Last, unless it is still up to date */
+	void _spine()
+	{
+		if(SpineTop >= 0)
+			return;
+		
+		SpineTop = 0;
+		for(NODE* cur = Root; cur != nullptr; cur = cur->isThreaded ? nullptr : cur->Right)
+			Spine[SpineTop++] = cur;
+	}
+	
+	
+	/* Links a new node whose key is greater than every
+	 * key in the tree below Last.  The cached right spine
+	 * is the search path, so there is no descent.  Since
+	 * the new node lands on the right spine, the only
+	 * rotation an append can cause is one left rotation
+	 * of a spine node, which drops that node off the
+	 * spine; the spine stays valid for the next append. */
+	void _append(NODE* newNode)
+	{
+		_spine();
+		
+		int top = SpineTop;  // # of nodes on the path
+		int valid = _link(newNode, (top == 0) ? nullptr : Spine[top - 1], Spine, top);
+		
+		if(valid < top)  // Spine[valid] rotated down to the left
+		{
+			for(int i = valid; i < top - 1; i++)
+				Spine[i] = Spine[i + 1];
+			
+			top--;
+		}
+		
+		Spine[top++] = newNode;
+		SpineTop = top;
+	}
+	
+	
+	/* Inserts key near the largest keys: appends it when
+	 * it is past Last, otherwise resumes the search from
+	 * the deepest spine node with a smaller key instead of
+	 * the root.  Returns the node holding key, new or not. */
+	NODE* _insertNear(const KeyT& key, const ValueT& value)
+	{
+		_spine();
+		
+		if(Last == nullptr || _less(Last->Key, key))  // Past the end, append
+		{
+			_stats().inserted(SpineTop, (Last != nullptr));
+			
+			NODE* newNode = _newNode(key, value);
+			_append(newNode);
+			return newNode;
+		}
+		
+		/* Spine keys grow going down, back up past the larger ones */
+		int i = SpineTop - 1;
+		int comparisons = 1;  // the call against Last
+		int order;
+		while(i >= 0 && (order = _compare(key, Spine[i]->Key, comparisons)) <= 0)
+		{
+			if(order == 0)  // Key already in tree
+			{
+				_stats().inserted(i + 1, comparisons);
+				return Spine[i];
+			}
+			
+			i--;
+		}
+		
+		/* Key is below Spine[i]'s right child; the spine
+		 * above it is the start of the search path */
+		NODE* path[MaxHeight + 1];
+		int   top = 0;
+		NODE* prev = nullptr;
+		
+		for(; top <= i; top++)
+			path[top] = Spine[top];
+		
+		NODE* cur = (i < 0) ? Root : Spine[i]->Right;
+		
+		while(cur != nullptr)
+		{
+			order = _compare(key, cur->Key, comparisons);
+			
+			if(order == 0)  // Key already in tree
+			{
+				_stats().inserted(top + 1, comparisons);
+				return cur;
+			}
+			
+			path[top++] = cur;
+			prev = cur;
+			
+			if(order < 0)  // Search left
+				cur = cur->Left;
+			else if(cur->isThreaded)  // Nothing to the right
+				cur = nullptr;
+			else
+				cur = cur->Right;
+		}
+		
+		_stats().inserted(top, comparisons);
+		
+		NODE* newNode = _newNode(key, value);
+		_link(newNode, prev, path, top);
+		return newNode;
+	}
+	
+	
+	/* Inserts key just before node h, insert_hint's hint
+	 * (not cend()).  If h is on the finger, the path of
+	 * the last key looked up here, or is that key's
+	 * successor, the search climbs from the bottom of the
+	 * finger only while key lies outside the subtree at
+	 * hand, then goes down from there; otherwise it
+	 * starts at the root.  Leaves the finger
+	 * on the path to key.  Returns the node holding key,
+	 * new or not. */
+	NODE* _insertHint(NODE* h, const KeyT& key, const ValueT& value)
+	{
+		NODE* path[MaxHeight + 1];  // Search path, Root first
+		int   top = 0;
+		int   comparisons = 0;
+		
+		bool near = (FingerTop > 0 && _next(Finger[FingerTop - 1]) == h);
+		
+		for(int j = FingerTop - 1; j >= 0 && !near; j--)
+			near = (Finger[j] == h);
+		
+		if(near)  // A hint next to the last key, climb
+		{
+			/* Keys under Finger[j] lie between lower[j] and
+			 * upper[j], the nearest nodes above it that the
+			 * path went right and left from (nullptr => none) */
+			NODE* lower[MaxHeight + 1];
+			NODE* upper[MaxHeight + 1];
+			
+			lower[0] = nullptr;
+			upper[0] = nullptr;
+			
+			for(int j = 1; j < FingerTop; j++)
+			{
+				bool isLeft = (Finger[j - 1]->Left == Finger[j]);
+				
+				lower[j] = isLeft ? lower[j - 1] : Finger[j - 1];
+				upper[j] = isLeft ? Finger[j - 1] : upper[j - 1];
+			}
+			
+			top = FingerTop - 1;  // Level to resume the search from
+			while(top > 0)
+			{
+				bool inside = true;
+				
+				if(lower[top] != nullptr)
+				{
+					comparisons++;
+					inside = _less(lower[top]->Key, key);
+				}
+				
+				if(inside && upper[top] != nullptr)
+				{
+					comparisons++;
+					inside = _less(key, upper[top]->Key);
+				}
+				
+				if(inside)  // Key belongs under Finger[top]
+					break;
+				
+				top--;
+			}
+			
+			for(int j = 0; j < top; j++)
+				path[j] = Finger[j];
+		}
+		
+		/* Go down from the level reached, Root if none */
+		NODE* cur = near ? Finger[top] : Root;
+		NODE* prev = (top == 0) ? nullptr : path[top - 1];
+		
+		while(cur != nullptr)
+		{
+			int order = _compare(key, cur->Key, comparisons);
+			
+			if(order == 0)  // Key already in tree
+			{
+				_stats().inserted(top + 1, comparisons);
+				
+				for(int j = 0; j < top; j++)
+					Finger[j] = path[j];
+				
+				Finger[top] = cur;
+				FingerTop = top + 1;
+				return cur;
+			}
+			
+			path[top++] = cur;
+			prev = cur;
+			
+			if(order < 0)  // Search left
+				cur = cur->Left;
+			else if(cur->isThreaded)  // Nothing to the right
+				cur = nullptr;
+			else
+				cur = cur->Right;
+		}
+		
+		_stats().inserted(top, comparisons);
+		
+		NODE* newNode = _newNode(key, value);
+		int   valid = _link(newNode, prev, path, top);
+		
+		/* The path above any rotation still leads to key;
+		 * redo the rest, down to the new node */
+		FingerTop = 0;
+		for(int j = 0; j + 1 < valid; j++)
+			Finger[FingerTop++] = path[j];
+		
+		for(cur = (valid == 0) ? Root : path[valid - 1]; cur != newNode; )
+		{
+			Finger[FingerTop++] = cur;
+			cur = _less(key, cur->Key) ? cur->Left : cur->Right;
+		}
+		
+		Finger[FingerTop++] = newNode;
+		return newNode;
+	}
+	
+	
+	/* Returns a pointer to 
+	 * the leftmost node */
+	static NODE* _begin(NODE* cur)
+	{
+		/* Check for empty tree */
+		if(cur == nullptr)
+		{
+			return nullptr;
+		}
+		else
+		{
+			/* Loop until the leftmost node */
+			while(cur->Left != nullptr)
+			{
+				cur = cur->Left; // Go Left
+			}
+		}
+		
+		return cur; // Return current node
+	}
+	
+	
+	/* Returns the inorder successor of cur by
+	 * following its thread, or the leftmost node
+	 * of its right subtree when not threaded */
+	static NODE* _next(NODE* cur)
+	{
+		if(cur->isThreaded)
+			return cur->Right; // Go right
+		else
+			return _begin(cur->Right);
+	}
+	
+	
+	/* Returns the first node whose key is not
+	 * less than key, or nullptr if there is none */
+	template<typename K>
+	NODE* _lowerBound(const K& key) const
+	{
+		NODE* cur = Root;        // Current Node
+		NODE* result = nullptr;  // Smallest key >= key seen so far
+		
+		while(cur != nullptr)
+		{
+			if(!_less(cur->Key, key))  // Candidate, look for a smaller one
+			{
+				result = cur;
+				cur = cur->Left;
+			}
+			else if(cur->isThreaded)  // Nothing to the right
+				cur = nullptr;
+			else
+				cur = cur->Right;
+		}
+		
+		return result;
+	}
+	
+	
+	/* Returns the first node whose key is
+	 * greater than key, or nullptr if none */
+	template<typename K>
+	NODE* _upperBound(const K& key) const
+	{
+		NODE* cur = Root;        // Current Node
+		NODE* result = nullptr;  // Smallest key > key seen so far
+		
+		while(cur != nullptr)
+		{
+			if(_less(key, cur->Key))  // Candidate, look for a smaller one
+			{
+				result = cur;
+				cur = cur->Left;
+			}
+			else if(cur->isThreaded)  // Nothing to the right
+				cur = nullptr;
+			else
+				cur = cur->Right;
+		}
+		
+		return result;
+	}
+	
+	
+	/* Returns the # of keys less than key, or less than
+	 * or equal to key when inclusive, by adding up the
+	 * left subtree sizes skipped on the way down */
+	template<typename K>
+	int _rank(const K& key, bool inclusive) const
+	{
+		NODE* cur = Root;  // Current Node
+		int   rank = 0;    // # of smaller keys passed so far
+		
+		while(cur != nullptr)
+		{
+			if(inclusive ? _less(key, cur->Key) : !_less(cur->Key, key))  // Go Left
+				cur = cur->Left;
+			else  // cur and its left subtree count, go Right
+			{
+				rank += _count(cur->Left) + 1;
+				cur = (cur->isThreaded) ? nullptr : cur->Right;
+			}
+		}
+		
+		return rank;
+	}
+	
+	
+	/* Hands a node to a range visitor.  Returns false
+	 * when the visitor asks to stop; visitors that
+	 * return nothing always continue. */
+	template<typename Visitor>
+	static bool _visit(Visitor& visit, const NODE* cur)
+	{
+		if constexpr (is_void<decltype(visit(cur->Key, cur->Value))>::value)
+		{
+			visit(cur->Key, cur->Value);
+			return true;
+		}
+		else
+		{
+			return visit(cur->Key, cur->Value);
+		}
+	}
+	
+	
+	/* Visits the nodes from cur onwards in inorder by
+	 * following the threads, stopping at the first key
+	 * past upper (or at upper itself when not inclusive)
+	 * or when the visitor says stop.  Returns the # of
+	 * nodes visited. */
+	template<typename K, typename Visitor>
+	size_t _scan(NODE* cur, const K& upper, bool inclusive, Visitor&& visit) const
+	{
+		size_t count = 0;  // # of nodes visited
+		
+		while(cur != nullptr)
+		{
+			if(inclusive ? _less(upper, cur->Key) : !_less(cur->Key, upper))  // Past upper
+				break;
+			
+			count++;
+			if(!_visit(visit, cur))  // Visitor is done
+				break;
+			
+			if(cur->isThreaded && cur->Right != nullptr)
+				_stats().hopped();
+			
+			cur = _next(cur);
+		}
+		
+		return count;
+	}
+	
+	
+	/* Reads n (key, value) pairs, already in key order,
+	 * with the given codecs and returns them as a chain
+	 * linked through Right, like _chain but without any
+	 * comparisons.  Keys and values may come from one
+	 * stream (records) or two (separate arrays). */
+	template<typename KeyCodec, typename ValueCodec>
+	NODE* _readChain(istream& keys, istream& values, int n)
+	{
+		NODE* head = nullptr;  // First node of the chain
+		NODE* tail = nullptr;  // Last node of the chain
+		
+		try
+		{
+			for(int i = 0; i < n; i++)
+			{
+				KeyT   key;
+				ValueT value;
+				
+				KeyCodec::read(keys, key);
+				ValueCodec::read(values, value);
+				
+				if(!keys || !values)
+					throw runtime_error("avlt::load: image is truncated");
+				
+				NODE* newNode = _newNode(std::move(key), std::move(value));
+				
+				if(tail == nullptr)
+					head = newNode;
+				else
+					tail->Right = newNode;
+				
+				tail = newNode;
+			}
+		}
+		catch(...)  // Read or copy failed, free the partial chain:
+		{
+			while(head != nullptr)
+			{
+				NODE* next = head->Right;
+				_freeNode(head);
+				head = next;
+			}
+			throw;
+		}
+		
+		return head;
+	}
+	
+	
+	/* Allocates a node for every (key, value) pair in
+	 * [first, last) and returns them as a chain linked
+	 * through Right, sorted by key with only the first
+	 * of equal keys kept; n is set to its length.  The
+	 * input is usually sorted already, in which case
+	 * this is one pass; otherwise the chain is sorted. */
+	template<typename InputIt>
+	NODE* _chain(InputIt first, InputIt last, int& n)
+	{
+		NODE* head = nullptr;  // First node of the chain
+		NODE* tail = nullptr;  // Last node of the chain
+		bool  sorted = true;   // false => some key came after a bigger one
+		n = 0;
+		
+		try
+		{
+			/* Allocate the nodes in order, linked through Right */
+			for( ; first != last; ++first)
+			{
+				if(tail != nullptr && sorted)
+				{
+					int order = _compare((*first).first, tail->Key);
+					
+					if(order == 0)
+						continue;  // Duplicate key, skip
+					
+					if(order < 0)
+						sorted = false;
+				}
+				
+				NODE* newNode = _newNode((*first).first, (*first).second);
+				
+				if(tail == nullptr)
+					head = newNode;
+				else
+					tail->Right = newNode;
+				
+				tail = newNode;
+				n++;
+			}
+		}
+		catch(...)  // Input or copy threw, free the partial chain:
+		{
+			while(head != nullptr)
 			{
-				_clear(cur->Right);
+				NODE* next = head->Right;
+				_freeNode(head);
+				head = next;
 			}
-			
-			delete cur; // Free node
+			throw;
 		}
-	}
-	
-	
-	/* Traverse through the tree using preorder 
-	 * and copy the nodes from the original tree */
-	void _copy(const NODE* cur)
-	{
-		if(cur == nullptr) // Tree is empty or tree
-			return;        // has ended so return
-		else
+		
+		if(sorted)
+			return head;
+		
+		/* Sort, then drop the repeats after the first */
+		NODE* rest = head;
+		head = _sortChain(rest, n);
+		
+		for(NODE* cur = head; cur != nullptr; )
 		{
-			/* Insert key and value into the node */
-			_insert(cur->Key, cur->Value);
-			_copy(cur->Left); // Go Left
+			NODE* next = cur->Right;
 			
-			/* Go Right when it's not threaded */	
-			if(!cur->isThreaded)
+			if(next != nullptr && !_less(cur->Key, next->Key))  // Repeat
 			{
-				_copy(cur->Right);
+				cur->Right = next->Right;
+				_freeNode(next);
+				n--;
 			}
-			
+			else
+				cur = next;
 		}
+		
+		return head;
 	}
 	
 	
-	/* Traverse through the tree using 
-	 * inorder and print the nodes */
-	void _print(NODE* cur, ostream& output)const
+	/* Stable merge sort of the next n nodes of a chain
+	 * linked through Right.  Returns the sorted chain
+	 * and advances head past the nodes taken. */
+	NODE* _sortChain(NODE*& head, int n) const
 	{
-		if(cur == nullptr) // Tree is empty or tree
-			return;        // has ended so return
-		else
+		if(n == 0)  // Nothing to sort
+			return nullptr;
+		
+		if(n == 1)  // One node is sorted
 		{
-			_print(cur->Left, output); // Go Left
-			
-			/* Print (Key, Value, Height, Thread) when node is threaded
-			 * and there is a node right of the current node.*/
-			if(cur->isThreaded && cur->Right != nullptr)
+			NODE* cur = head;
+			head = head->Right;
+			cur->Right = nullptr;
+			return cur;
+		}
+		
+		NODE*  left = _sortChain(head, n / 2);
+		NODE*  right = _sortChain(head, n - n / 2);
+		NODE*  merged = nullptr;   // First node of the merged chain
+		NODE** link = &merged;     // Where the next node gets linked
+		
+		/* Merge, taking from the left on ties to keep the input order */
+		while(left != nullptr && right != nullptr)
+		{
+			if(_less(right->Key, left->Key))
 			{
-				output << "(" << cur->Key << "," << cur->Value << ","
-				<< cur->Height << "," << cur->Right->Key << ")"<< endl;
+				*link = right;
+				right = right->Right;
 			}
 			else
 			{
-				/* Print (Key, Value, Height) when node is not 
-				 * threaded and go right to the next node */
-				output << "(" << cur->Key << "," << cur->Value
-				       << "," << cur->Height<< ")"<< endl;
-				_print(cur->Right, output); // Go Right
+				*link = left;
+				left = left->Right;
 			}
-				
+			
+			link = &(*link)->Right;
 		}
+		
+		*link = (left != nullptr) ? left : right;
+		return merged;
 	}
 	
 	
-	/* This function rotates the tree
-	 * to the left when it's broken
-	 * and updates the height */
-	void _LeftRotate(NODE* Parent, NODE* N)
+	/* Builds a perfectly balanced subtree out of the
+	 * next n nodes of a sorted chain linked through
+	 * Right, advancing head past them.  Heights and
+	 * right threads are set on the way back up. */
+	NODE* _build(NODE*& head, int n)
 	{
-		NODE* A = N->Left;        // 100   N      
-		NODE* R = N->Right;       //  
-		NODE* B = R->Left;        //     110   R
-		NODE* C = R->Right;       // 
-		                          //         120   C
-    
-		// Make left rotation:
-	    R->Left = N;
-		N->Right = B;
+		if(n == 0)  // Nothing left for this subtree
+			return nullptr;
 		
-		// Rethread after rotation:
-		if(B == nullptr)
-		{
-			N->Right = R;
-			N->isThreaded = true;
-		}
+		int nL = n / 2;         // # of nodes to the left
+		int nR = n - nL - 1;    // # of nodes to the right
 		
-		// Check if N has a parent: 
-		if(Parent == nullptr)
+		NODE* left = _build(head, nL);  // Build left
+		
+		NODE* cur = head;   // Next node in order is the root
+		head = head->Right; // Move down the chain
+		
+		cur->Left = left;
+		
+		if(nR == 0)  // No right subtree, thread to inorder successor:
 		{
-			Root = R;  // No parent, so R becomes root
+			cur->Right = head;
+			cur->isThreaded = true;
 		}
-		else if(Parent->Left == N)
+		else  // Build right
 		{
-			Parent->Left = R;  // Relink Parent's left pointer
+			cur->Right = _build(head, nR);
+			cur->isThreaded = false;
 		}
-		else
+		
+		int hL = (cur->Left == nullptr) ? -1 : cur->Left->Height;
+		int hR = (cur->isThreaded) ? -1 : cur->Right->Height;
+		cur->Height = 1 + max(hL, hR);
+		
+		if constexpr (OrderStats)
+			cur->Count = n;
+		
+		return cur;
+	}
+	
+	
+	// Set operations split their work across threads only while both
+	// subtrees are at least this tall (some thousands of nodes each)
+	static const int ParallelSetHeight = 12;
+	
+	
+	/* A subtree cut loose from its tree, for join and split.
+	 * Max is its rightmost node, whose thread is pointed at
+	 * whatever follows the subtree once it is attached.  A
+	 * nullptr Max means the rightmost node is not known, but
+	 * already threads to the node that will follow it: a left
+	 * child's rightmost node threads to its parent, so taking
+	 * one apart never has to walk down to find it. */
+	struct SUB
+	{
+		NODE* Root;
+		NODE* Max;
+	};
+	
+	/* The result of _split: the keys less than the split
+	 * key, the node holding it (if any), and the greater keys */
+	struct SPLIT
+	{
+		SUB   Less;
+		NODE* Found;
+		SUB   Greater;
+	};
+	
+	enum SETOP { SetUnion, SetIntersection, SetDifference };
+	
+	
+	/* Height of the subtree rooted
+	 * at cur, -1 when it's empty */
+	static int _height(const NODE* cur)
+	{
+		return (cur == nullptr) ? -1 : cur->Height;
+	}
+	
+	
+	/* Right child of cur, 
+	 * nullptr when threaded */
+	static NODE* _right(const NODE* cur)
+	{
+		return cur->isThreaded ? nullptr : cur->Right;
+	}
+	
+	
+	/* Follows real right children 
+	 * down to the rightmost node */
+	static NODE* _rightmost(NODE* cur)
+	{
+		while(!cur->isThreaded)
+			cur = cur->Right;
+		
+		return cur;
+	}
+	
+	
+	/* Recomputes cur's height and 
+	 * subtree size from its children */
+	static void _fix(NODE* cur)
+	{
+		cur->Height = 1 + max(_height(cur->Left), _height(_right(cur)));
+		_recount(cur);
+	}
+	
+	
+	/* Makes the subtree rooted at cur its right child's
+	 * left child; returns the new root of the subtree */
+	static NODE* _rotateLeft(NODE* cur)
+	{
+		NODE* R = cur->Right;
+		
+		if(R->Left != nullptr)  // R's left subtree moves under cur
+			cur->Right = R->Left;
+		else                    // cur is left with a thread to R
+			cur->isThreaded = true;
+		
+		R->Left = cur;
+		_fix(cur);
+		_fix(R);
+		return R;
+	}
+	
+	
+	/* Makes the subtree rooted at cur its left child's
+	 * right child; returns the new root of the subtree */
+	static NODE* _rotateRight(NODE* cur)
+	{
+		NODE* L = cur->Left;
+		
+		/* L's right subtree moves under cur, still threading to cur */
+		cur->Left = _right(L);
+		L->Right = cur;
+		L->isThreaded = false;
+		_fix(cur);
+		_fix(L);
+		return L;
+	}
+	
+	
+	/* Hangs left and right off k, pointing the
+	 * rightmost node of left at k when it's known */
+	static SUB _attach(SUB left, NODE* k, SUB right)
+	{
+		k->Left = left.Root;
+		
+		if(left.Root != nullptr && left.Max != nullptr)
 		{
-			Parent->Right = R;  // Relink Parent's right pointer
+			left.Max->Right = k;
+			left.Max->isThreaded = true;
 		}
-     
-		int HA;  // Height of A
-		int HB;  // Height of B 
-		int HC;  // Height of C
-     
-		if(A == nullptr)  // No node, make height -1:
+		
+		if(right.Root != nullptr)
 		{
-			HA = -1;
+			k->Right = right.Root;
+			k->isThreaded = false;
 		}
-		else  // Node exists, get height:
+		else  // k is the rightmost node, its thread is set later
 		{
-			HA = A->Height;
+			k->Right = nullptr;
+			k->isThreaded = true;
 		}
-     
-		if(B == nullptr)  // No node, make height -1:
-		{ 
-			HB = -1;
+		
+		_fix(k);
+		return SUB{k, (right.Root != nullptr) ? right.Max : k};
+	}
+	
+	
+	/* Joins when left is the taller tree: walks down its right 
+	 * spine to a subtree c no more than one taller than right,
+	 * puts k there with c and right below it, and rotates on 
+	 * the way back up wherever that made a node lopsided */
+	static SUB _joinRight(SUB left, NODE* k, SUB right)
+	{
+		NODE* top = left.Root;
+		SUB   c = {_right(top), left.Max};  // c ends where left ends
+		SUB   t;
+		
+		if(_height(c.Root) <= _height(right.Root) + 1)
+		{
+			t = _attach(c, k, right);
+			
+			/* k is two taller than top's left, so it leans left: */
+			if(t.Root->Height > _height(top->Left) + 1)
+				t.Root = _rotateRight(t.Root);
 		}
-		else  // Node exists, get height:
+		else
+			t = _joinRight(c, k, right);
+		
+		top->Right = t.Root;
+		top->isThreaded = false;
+		_fix(top);
+		
+		if(t.Root->Height > _height(top->Left) + 1)
+			top = _rotateLeft(top);
+		
+		return SUB{top, t.Max};
+	}
+	
+	
+	/* Mirror image of _joinRight, when right is the taller
+	 * tree: k goes down its left spine.  The left subtrees
+	 * there already thread to their parents, so the pieces
+	 * are passed down with an unknown Max. */
+	static SUB _joinLeft(SUB left, NODE* k, SUB right)
+	{
+		NODE* top = right.Root;
+		SUB   c = {top->Left, nullptr};  // c threads to top
+		SUB   t;
+		
+		if(_height(c.Root) <= _height(left.Root) + 1)
 		{
-			HB = B->Height;
+			t = _attach(left, k, c);
+			
+			/* k is two taller than top's right, so it leans right: */
+			if(t.Root->Height > _height(_right(top)) + 1)
+				t.Root = _rotateLeft(t.Root);
 		}
-     
-		if(C == nullptr)  // No node, make height -1:
+		else
+			t = _joinLeft(left, k, c);
+		
+		top->Left = t.Root;
+		if(t.Max != nullptr)  // k was the rightmost, thread it to top
 		{
-			HC = -1;
+			t.Max->Right = top;
+			t.Max->isThreaded = true;
 		}
-		else  // Node exists, get height:
+		_fix(top);
+		
+		if(t.Root->Height > _height(_right(top)) + 1)
+			top = _rotateRight(top);
+		
+		return SUB{top, right.Max};
+	}
+	
+	
+	/* Joins left, k and right into one AVL tree, where
+	 * every key in left is less than k's and every key
+	 * in right greater.  O(|height(left) - height(right)|). */
+	static SUB _join(SUB left, NODE* k, SUB right)
+	{
+		if(_height(left.Root) > _height(right.Root) + 1)
+			return _joinRight(left, k, right);
+		
+		if(_height(right.Root) > _height(left.Root) + 1)
+			return _joinLeft(left, k, right);
+		
+		return _attach(left, k, right);
+	}
+	
+	
+	/* Takes the rightmost node out of tree, which must 
+	 * not be empty, returning it in last.  The rest keeps
+	 * threading to last, so its Max comes back unknown
+	 * unless that is tree's root. */
+	static SUB _splitLast(SUB tree, NODE*& last)
+	{
+		NODE* top = tree.Root;
+		NODE* right = _right(top);
+		
+		if(right == nullptr)  // top is the rightmost node
 		{
-			HC = C->Height;
+			last = top;
+			return SUB{top->Left, nullptr};
 		}
-     
-		 N->Height = 1 + max(HA, HB);        // Update height of N
-		 R->Height = 1 + max(HC, N->Height); // Update height of R
-     }
-	 
-	 
-	 /* This function rotates the tree
-	  * to the right when it's broken
-	  * and updates the height */
-	 void _RightRotate(NODE* Parent, NODE* N)
-	 {
-		 NODE* L = N->Left;        //            3   N      
-		 NODE* A = L->Left;        //
-		 NODE* B = L->Right;       //        2    L
-		 NODE* C = N->Right;       //
-                                   //    1     A
-		                           //
-		 
-		 // Unlink threading for rotation:
-	     if(L->isThreaded)
-		 {
-			B = nullptr;
-		 }
-		 if(N->isThreaded)
-		 {
-			C = nullptr;
-		 }
-		 
-		 // Make right rotation and unthread:
-		 L->Right = N;
-		 L->isThreaded = false;
-		 N->Left = B;
-		 
-		 // Check if N has a parent:
-		 if(Parent == nullptr)
-		 {
-			 Root = L;  // No parent, so L becomes root
-		 }
-		 else if(Parent->Left == N)
-		 {
-			 Parent->Left = L;  // Relink Parent's left pointer
-         }
-		 else 
-		 {
-			 Parent->Right = L;  // Relink Parent's right pointer
-		 }
-		 
-		 int HA;  // Height of A
-		 int HB;  // Height of B
-		 int HC;  // Height of C
-      
-		 if(A == nullptr)  // No node, make height -1:
-		 {
-			HA = -1; 
-		 }
-		 else  // Node exists, get height:
-		 {
-			HA = A->Height;
-		 }
-      
-		 if(B == nullptr)  // No node, make height -1:
-		 {
-			HB = -1; 
-		 }
-		 else  // Node exists, get height:
-		 {
-			HB = B->Height;
-		 }
-      
-		 if(C == nullptr)  // No node, make height -1:
-		 {
-			HC = -1; 
-		 }
-		 else  // Node exists, get height:
-		 {
-			HC = C->Height;
-		 }
-      
-		 N->Height = 1 + max(HB, HC);        // Update height of N
-		 L->Height = 1 + max(HA, N->Height); // Update height of L
-	  }
+		
+		SUB rest = _splitLast(SUB{right, tree.Max}, last);
+		return _join(SUB{top->Left, nullptr}, top, rest);
+	}
+	
+	
+	/* Joins left and right without a middle key,
+	 * by borrowing the rightmost node of left */
+	static SUB _join2(SUB left, SUB right)
+	{
+		if(left.Root == nullptr)
+			return right;
+		
+		if(right.Root == nullptr)
+		{
+			/* An unknown Max threads to a node that was left out */
+			if(left.Max == nullptr)
+				left.Max = _rightmost(left.Root);
+			
+			return left;
+		}
+		
+		NODE* last;
+		SUB   rest = _splitLast(left, last);
+		return _join(rest, last, right);
+	}
 	
 	
-	/* Returns a pointer to 
-	 * the leftmost node */
-	NODE* _begin(NODE* cur)
+	/* Splits tree into the keys less than key and the keys
+	 * greater, joining back the pieces along the search
+	 * path.  O(lgN).  The node holding key comes out on its
+	 * own, with stale links.  The Max of the lesser part may
+	 * come back unknown yet threading to a node now in the 
+	 * other part (see _cut); the greater part's is tree's. */
+	SPLIT _split(SUB tree, const KeyT& key) const
 	{
-		/* Check for empty tree */
-		if(cur == nullptr)
+		if(tree.Root == nullptr)
+			return SPLIT{SUB{nullptr, nullptr}, nullptr, SUB{nullptr, nullptr}};
+		
+		NODE* top = tree.Root;
+		SUB   left = {top->Left, nullptr};  // Threads to top
+		SUB   right = {_right(top), tree.Max};
+		
+		int order = _compare(key, top->Key);
+		
+		if(order == 0)  // Found key
+			return SPLIT{left, top, right};
+		
+		if(order < 0)  // Go left, top and right go with the greater keys
 		{
-			return nullptr;
+			SPLIT s = _split(left, key);
+			s.Greater = _join(s.Greater, top, right);
+			return s;
 		}
-		else
+		
+		/* Go right, left and top go with the lesser keys */
+		SPLIT s = _split(right, key);
+		s.Less = _join(left, top, s.Less);
+		return s;
+	}
+	
+	
+	/* _split, but with the Max of the lesser part
+	 * always known: safe to hand to any join */
+	SPLIT _cut(SUB tree, const KeyT& key) const
+	{
+		SPLIT s = _split(tree, key);
+		
+		if(s.Less.Root != nullptr && s.Less.Max == nullptr)
+			s.Less.Max = _rightmost(s.Less.Root);
+		
+		return s;
+	}
+	
+	
+	/* Detaches a node taken out of a tree, so that it
+	 * can be freed on its own by _discard */
+	static void _single(NODE* cur)
+	{
+		cur->Left = nullptr;
+		cur->Right = nullptr;
+		cur->isThreaded = true;
+	}
+	
+	
+	/* Frees the subtree rooted at cur; 
+	 * returns the # of nodes freed */
+	int _discard(NODE* cur)
+	{
+		NODE* nodes[MaxHeight + 2]; // Nodes waiting to be freed
+		int   top = 0;              // # of nodes on the stack
+		int   count = 0;            // # of nodes freed
+		
+		if(cur == nullptr) // Tree is empty
+			return 0;
+		
+		nodes[top++] = cur;
+		
+		while(top > 0)
 		{
-			/* Loop until the leftmost node */
-			while(cur->Left != nullptr)
-			{
-				cur = cur->Left; // Go Left
-			}
+			cur = nodes[--top];
+			
+			if(cur->Left != nullptr)  // Go Left later
+				nodes[top++] = cur->Left;
+			
+			if(!cur->isThreaded)      // Go Right later
+				nodes[top++] = cur->Right;
+			
+			_freeNode(cur);
+			count++;
 		}
 		
-		return cur; // Return current node
+		return count;
 	}
-
-	void _insert(KeyT key, ValueT value)
+	
+	
+	/* Runs first() here and second() on another thread when
+	 * big and a thread is left in the budget, otherwise both
+	 * here, one after the other.  A thread goes back into the
+	 * budget as soon as it's done, for some other subtree to
+	 * take up.  Exceptions from either side are rethrown. */
+	template<typename First, typename Second>
+	static void _fork(bool big, atomic<int>& budget, First&& first, Second&& second)
 	{
-		NODE* prev = nullptr; // Previous Node
-		NODE* cur = Root; // Current Node
-		stack<NODE*> nodes; // Declare stack of nodes to check heights
-
-		/* Search to see if tree already contains key */
-		while (cur != nullptr)
+		if(!big || budget.fetch_sub(1) <= 0)  // Stay on this thread
 		{
-			if (key == cur->Key)  // Key already in tree
-				return;
+			if(big)
+				budget++;
+			
+			first(false);
+			second(false);
+			return;
+		}
 		
-			nodes.push(cur); // stack so we can return later
+		exception_ptr error;  // Exception from the other thread
+		thread worker;
 		
-			if (key < cur->Key)  // Search left
-			{
-				prev = cur;
-				cur = cur->Left;
-			}
-			else // Search right
+		try
+		{
+			worker = thread([&]()
 			{
-				prev = cur;
-				if(cur->isThreaded)
+				try
 				{
-					cur = nullptr;
+					second(true);
 				}
-				else // Not Threaded
-				{   
-					cur = cur->Right; // Move right
+				catch(...)
+				{
+					error = current_exception();
 				}
+				budget++;
+			});
+		}
+		catch(...)  // No thread to be had, do both here
+		{
+			budget++;
+			first(false);
+			second(false);
+			return;
+		}
+		
+		try
+		{
+			first(false);
+		}
+		catch(...)
+		{
+			worker.join();
+			throw;
+		}
+		
+		worker.join();
+		
+		if(error)
+			rethrow_exception(error);
+	}
+	
+	
+	/* Union, intersection or difference of a and b, made
+	 * of their own nodes: a's root is the pivot, b is split
+	 * by its key, and the two halves are done recursively,
+	 * in parallel when they are big, then joined back with
+	 * the pivot (if it stays) in the middle.  Of two equal
+	 * keys a's node is the one kept.  Nodes left out go to
+	 * garbage, whole subtrees at a time, to be freed once
+	 * the threads are done, as the allocator is not shared.
+	 * O(m lg(n/m + 1)) for sizes m <= n. */
+	SUB _setOp(SETOP op, SUB a, SUB b, vector<NODE*>& garbage, atomic<int>& budget) const
+	{
+		if(a.Root == nullptr || b.Root == nullptr)
+		{
+			if(op == SetUnion)
+				return (a.Root != nullptr) ? a : b;
+			
+			if(b.Root != nullptr)  // Nothing in a to match it
+				garbage.push_back(b.Root);
+			
+			if(a.Root != nullptr && op == SetIntersection)
+			{
+				garbage.push_back(a.Root);
+				return SUB{nullptr, nullptr};
 			}
-		}//while
-
-		/* Key is not in tree, so a new 
-		* node is allocated to insert */
-		NODE* newNode = new NODE();
-	    newNode->Key = key;
-	    newNode->Value = value;
-        newNode->Left = nullptr;
-        newNode->Right = nullptr;
-	    newNode->isThreaded = true;
-	    newNode->Height = 0;
-	  
-		//
-		// NOTE: cur is null, and prev denotes node where
-        // we fell out of the tree.  if prev is null, then
-        // the tree is empty and the Root pointer needs 
-        // to be updated.
-        //
-
-		if(prev == nullptr)
-			Root = newNode;
-		else if (key < prev->Key)
+			
+			return a;
+		}
+		
+		NODE* k = a.Root;
+		SUB   aLess = {k->Left, nullptr};  // Threads to k
+		SUB   aGreater = {_right(k), a.Max};
+		SPLIT s = _cut(b, k->Key);
+		SUB   less, greater;
+		bool  big = min(k->Height, b.Root->Height) >= ParallelSetHeight;
+		
+		vector<NODE*> more;  // Garbage of the other thread
+		
+		_fork(big, budget,
+			[&](bool) { less = _setOp(op, aLess, s.Less, garbage, budget); },
+			[&](bool forked) 
+			{ 
+				greater = _setOp(op, aGreater, s.Greater, forked ? more : garbage, budget); 
+			});
+		
+		garbage.insert(garbage.end(), more.begin(), more.end());
+		
+		if(s.Found != nullptr)  // Equal keys, the one from b goes
 		{
-			prev->Left = newNode;  // Insert new node to the left of the previous
-			newNode->Right = prev; // Point new node's right pointer 
-								   // to the node on the right
+			_single(s.Found);
+			garbage.push_back(s.Found);
 		}
-		else
-		{   
-			newNode->Right = prev->Right;
-			prev->isThreaded = false; 
-			prev->Right = newNode;        // Insert new node to the right of the previous
+		
+		if(op == SetUnion || (op == SetIntersection) == (s.Found != nullptr))
+			return _join(less, k, greater);
+		
+		_single(k);
+		garbage.push_back(k);
+		return _join2(less, greater);
+	}
+	
+	
+	/* Makes this tree the union, intersection or difference
+	 * of itself and other, which is left empty.  other's
+	 * allocator is spliced into ours first, so that every
+	 * node ends up owned by this tree. */
+	void _setOps(SETOP op, avlt& other, int threads)
+	{
+		if(this == &other)  // Same keys on both sides
+		{
+			if(op == SetDifference)
+				clear();
+			
+			return;
 		}
-         
-		Size++; // Update Size
-	  
-		// Walk back up tree using stack and update heights:
-		while (!nodes.empty())
+		
+		Alloc.splice(other.Alloc);
+		
+		SUB a = {Root, Last};
+		SUB b = {other.Root, other.Last};
+		int total = Size + other.Size;  // # of nodes, before the garbage
+		
+		other.Root = nullptr;
+		other.Size = 0;
+		other.Current = nullptr;
+		other._ends();
+		
+		vector<NODE*> garbage;  // Subtrees left out of the result
+		atomic<int>   budget(max(threads, 1) - 1);  // # of extra threads free
+		SUB           result = _setOp(op, a, b, garbage, budget);
+		
+		if(result.Root != nullptr)  // Thread the last node to nowhere
 		{
-			cur = nodes.top(); // Make current top of stack
-		    nodes.pop();
-		 
-			int hL = (cur->Left == nullptr) ? -1 : cur->Left->Height;
-			int hR = (cur->Right == nullptr || cur->isThreaded) ? -1 : cur->Right->Height; // check for threading
-			int hCur = 1 + max(hL, hR);
-
-			if (cur->Height == hCur)  // didn't change, so no need to go further:
-				break;
-			else   // height changed, update and keep going:
-				cur->Height = hCur;
+			if(result.Max == nullptr)
+				result.Max = _rightmost(result.Root);
+			
+			result.Max->Right = nullptr;
+			result.Max->isThreaded = true;
 		}
-
+		
+		for(NODE* cur : garbage)
+			total -= _discard(cur);
+		
+		Root = result.Root;
+		Size = total;
+		Current = nullptr;
+		_ends();
 	}
 
-public:
+public:
+  //
+  // default constructor:
+  //
+  // Creates an empty tree.
+  //
+  avlt()
+  {
+    Root = nullptr;
+    Current = nullptr;
+    First = nullptr;
+    Last = nullptr;
+    Size = 0;
+    SpineTop = -1;
+    FingerTop = 0;
+  }
+
+  //
+  // comparator constructor:
+  //
+  // Creates an empty tree ordered by the given comparator, for a
+  // Compare that carries state.
+  //
+  explicit avlt(const Compare& compare)
+    : Compare(compare)
+  {
+    Root = nullptr;
+    Current = nullptr;
+    First = nullptr;
+    Last = nullptr;
+    Size = 0;
+    SpineTop = -1;
+    FingerTop = 0;
+  }
+
+  //
+  // copy constructor
+  //
+  // NOTE: makes an exact copy of the "other" tree, such that making the
+  // copy requires no rotations.
+  //
+  // Time complexity:  O(N)
+  //
+  avlt (const avlt& other)
+    : Compare(other)
+  {
+    Root = nullptr; 
+    Current = nullptr;
+    First = nullptr;
+    Last = nullptr;
+    Size = 0;
+    SpineTop = -1;
+    FingerTop = 0;
+	_copy(other, 1);
+  }
+
+  //
+  // move constructor
+  //
+  // Takes over the nodes of the "other" tree, which is left empty.
+  //
+  // Time complexity:  O(1)
+  //
+  avlt (avlt&& other) noexcept
+    : Compare(other)
+  {
+    Root = other.Root;
+    Current = other.Current;
+    First = other.First;
+    Last = other.Last;
+    Size = other.Size;
+    SpineTop = -1;
+    FingerTop = 0;
+    Alloc.swap(other.Alloc);
+    
+    other.Root = nullptr;
+    other.Current = nullptr;
+    other.First = nullptr;
+    other.Last = nullptr;
+    other.Size = 0;
+    other.SpineTop = -1;
+    other.FingerTop = 0;
+  }
+
+  //
+  // range constructor
+  //
+  // Builds the tree from a sorted range of (key, value) pairs; see
+  // assign_sorted.
+  //
+  template<typename InputIt>
+  avlt(InputIt first, InputIt last, const Compare& compare = Compare())
+    : Compare(compare)
+  {
+    Root = nullptr;
+    Current = nullptr;
+    First = nullptr;
+    Last = nullptr;
+    Size = 0;
+    SpineTop = -1;
+    FingerTop = 0;
+    assign_sorted(first, last);
+  }
+
+	//
+  // destructor:
+  //
+  // Called automatically by system when tree is about to be destroyed;
+  // this is our last chance to free any resources / memory used by
+  // this tree.
+  //
+  virtual ~avlt()
+  {
+    clear();
+  }
+
+  //
+  // operator=
+  //
+  // Clears "this" tree and then makes a copy of the "other" tree.
+  //
+  // NOTE: makes an exact copy of the "other" tree, such that making the
+  // copy requires no rotations.
+  //
+  avlt& operator=(const avlt& other)
+  {
+    if(this == &other)  // Self assignment, nothing to do
+      return *this;
+    
+    clear();
+    static_cast<Compare&>(*this) = other;
+	_copy(other, 1);
+	 
+    return *this;
+  }
+
+  //
+  // move operator=
+  //
+  // Clears "this" tree and then takes over the nodes of the "other"
+  // tree, which is left empty.
+  //
+  avlt& operator=(avlt&& other) noexcept
+  {
+    if(this == &other)  // Self assignment, nothing to do
+      return *this;
+    
+    clear();
+    static_cast<Compare&>(*this) = other;
+    
+    Root = other.Root;
+    Current = other.Current;
+    First = other.First;
+    Last = other.Last;
+    Size = other.Size;
+    Alloc.swap(other.Alloc);
+    
+    other.Root = nullptr;
+    other.Current = nullptr;
+    other.First = nullptr;
+    other.Last = nullptr;
+    other.Size = 0;
+    other.SpineTop = -1;
+    other.FingerTop = 0;
+    
+    return *this;
+  }
+
+  //
+  // copy_from
+  //
+  // Same as operator=, except that for large trees the subtrees below
+  // the top levels of "other" are cloned on up to "threads" threads
+  // (the calling thread included).  "other" must not be modified while
+  // the copy runs.
+  //
+  // Time complexity:  O(N / threads) for large trees
+  //
+  void copy_from(const avlt& other, int threads = (int)thread::hardware_concurrency())
+  {
+    if(this == &other)  // Self assignment, nothing to do
+      return;
+    
+    clear();
+    static_cast<Compare&>(*this) = other;
+    _copy(other, threads);
+  }
+
+  //
+  // clear:
+  //
+  // Clears the contents of the tree, resetting the tree to empty.
+  //
+  void clear()
+  {
+    _stats().freed((uint64_t)Size);
+    
+    /* Trivial keys and values need no destructor calls, so a
+     * bulk allocator can drop every node without a tree walk */
+    if(!(NodeAlloc<NODE>::releases_all &&
+         is_trivially_destructible<KeyT>::value &&
+         is_trivially_destructible<ValueT>::value))
+    {
+      _clear(Root, Alloc);
+    }
+    
+    Alloc.release();
+	Root = nullptr;
+	Current = nullptr;
+	First = nullptr;
+	Last = nullptr;
+	Size = 0;
+	SpineTop = -1;
+	FingerTop = 0;
+  }
+
+  //
+  // assign_sorted:
+  //
+  // Replaces the contents of the tree with the (key, value) pairs in
+  // [first, last), which should be sorted by ascending key; of equal
+  // keys only the first is kept, just like insert.  Elements only need
+  // .first and .second, and the range may be a single-pass input range
+  // of unknown length.  The result is perfectly balanced and needs no
+  // rotations.  An unsorted range is sorted first.
+  //
+  // Time complexity:  O(N) for sorted input, O(NlgN) otherwise
+  //
+  template<typename InputIt>
+  void assign_sorted(InputIt first, InputIt last)
+  {
+    clear();
+    
+    int   n;                               // # of nodes in the chain
+    NODE* head = _chain(first, last, n);   // Sorted chain of new nodes
+    
+    Root = _build(head, n);
+    Size = n;
+    _ends();
+  }
+
+  //
+  // insert_batch:
+  //
+  // Inserts every (key, value) pair in [first, last); keys already in
+  // the tree, and repeats within the batch after the first, are
+  // skipped just like insert.  The batch may be any input range, and
+  // is sorted first if it is not already in ascending order.
+  //
+  // A batch that is dense relative to the tree (M * height >= 2N) is
+  // merged with an inorder walk along the threads and the whole tree
+  // is rebuilt perfectly balanced from the merged chain, reusing the
+  // existing nodes: O(N + M) with no searches and no rotations.  A
+  // sparser batch is inserted key by key, but each search resumes from
+  // the deepest node on the previous key's path whose subtree still
+  // covers the new key (a finger search), so neighbouring keys skip
+  // the shared part of the descent.
+  //
+  // Time complexity:  O(min(N + M, M lgN)) for a sorted batch
+  //
+  template<typename InputIt>
+  void insert_batch(InputIt first, InputIt last)
+  {
+    int   m;                               // # of new nodes
+    NODE* batch = _chain(first, last, m);  // Sorted chain of new nodes
+    
+    if(m == 0)  // Nothing to insert
+      return;
+    
+    if(Root == nullptr)  // Empty tree, just build it
+    {
+      for(int i = 0; i < m; i++)
+        _stats().inserted(0, 0);
+      
+      Root = _build(batch, m);
+      Size = m;
+      _ends();
+      return;
+    }
+    
+    /* Sparse batch, link the new nodes in one at a time */
+    if((long long)m * (Root->Height + 1) < 2LL * Size)
+    {
+      NODE* path[MaxHeight + 1];   // Search path of the previous key
+      NODE* upper[MaxHeight + 1];  // upper[i]: keys under path[i] are less
+      int   top = 0;               // than this node's key (nullptr => no limit)
+      
+      while(batch != nullptr)
+      {
+        NODE* newNode = batch;
+        batch = batch->Right;
+        int   depth = 0;        // # of nodes searched, for the stats
+        int   comparisons = 0;  // # of calls of Compare, for the stats
+        
+        /* Keys only grow, so back up to the deepest subtree
+         * on the old path that can still hold this key */
+        while(top > 0 && upper[top - 1] != nullptr &&
+              (comparisons++, !_less(newNode->Key, upper[top - 1]->Key)))
+          top--;
+        
+        NODE* cur = (top == 0) ? Root : path[top - 1];  // Resume the search here
+        NODE* limit = (top == 0) ? nullptr : upper[top - 1];
+        NODE* prev = nullptr;
+        
+        if(top > 0)  // path[top-1] is searched again below
+          top--;
+        
+        /* Search down from there, extending the path */
+        int order;
+        while(cur != nullptr && (depth++, order = _compare(newNode->Key, cur->Key, comparisons)) != 0)
+        {
+          path[top] = cur;
+          upper[top] = limit;
+          top++;
+          prev = cur;
+          
+          if(order < 0)  // Search left
+          {
+            limit = cur;
+            cur = cur->Left;
+          }
+          else if(cur->isThreaded)  // Nothing to the right
+            cur = nullptr;
+          else  // Search right
+            cur = cur->Right;
+        }
+        
+        _stats().inserted(depth, comparisons);
+        
+        if(cur != nullptr)  // Key already in tree
+        {
+          _freeNode(newNode);
+          continue;
+        }
+        
+        newNode->Right = nullptr;  // Unlink from the chain
+        top = _link(newNode, prev, path, top);
+      }
+      
+      return;
+    }
+    
+    /* Dense batch, merge both in order into one chain.  Each
+     * tree node's successor is found before the node is
+     * relinked, and relinked nodes are never visited again */
+    NODE* cur = First;         // Next tree node in order
+    NODE* head = nullptr;      // First node of the merged chain
+    NODE* tail = nullptr;      // Last node of the merged chain
+    int   n = 0;               // # of nodes in the merged chain
+    int   compared = 0;        // tree nodes the batch head was compared with
+    int   calls = 0;           // calls of Compare made for the batch head
+    
+    while(cur != nullptr || batch != nullptr)
+    {
+      NODE* next;  // Node to append
+      int   order = (batch == nullptr) ? -1 : (cur == nullptr) ? 1 : (compared++, _compare(cur->Key, batch->Key, calls));
+      
+      if(order < 0)
+      {
+        next = cur;
+        cur = _next(cur);
+      }
+      else if(order == 0)  // Key already in tree
+      {
+        _stats().inserted(compared, calls);
+        compared = 0;
+        calls = 0;
+        
+        NODE* dup = batch;
+        batch = batch->Right;
+        _freeNode(dup);
+        continue;
+      }
+      else
+      {
+        _stats().inserted(compared, calls);
+        compared = 0;
+        calls = 0;
+        
+        next = batch;
+        batch = batch->Right;
+      }
+      
+      if(tail == nullptr)
+        head = next;
+      else
+        tail->Right = next;
+      
+      tail = next;
+      n++;
+    }
+    
+    tail->Right = nullptr;
+    Root = _build(head, n);
+    Size = n;
+    _ends();
+  }
+
   //
-  // default constructor:
+  // join:
   //
-  // Creates an empty tree.
+  // Appends key, value and then every pair of right to this tree, and
+  // leaves right empty.  Every key in this tree must be less than key,
+  // and key less than every key in right, otherwise invalid_argument is
+  // thrown and nothing changes.  No node is copied: right's nodes, and
+  // its allocator's memory, are taken over as they are.
   //
-  avlt()
+  // Time complexity:  O(lgN)
+  //
+  void join(const KeyT& key, const ValueT& value, avlt& right)
   {
-    Root = nullptr;
-    Size = 0;
+    if(this == &right ||
+       (Last != nullptr && !_less(Last->Key, key)) ||
+       (right.First != nullptr && !_less(key, right.First->Key)))
+    {
+      throw invalid_argument("avlt::join: keys are not in order");
+    }
+    
+    NODE* k = _newNode(key, value);
+    
+    Alloc.splice(right.Alloc);
+    
+    SUB joined = _join(SUB{Root, Last}, k, SUB{right.Root, right.Last});
+    joined.Max->Right = nullptr;  // Thread the last node to nowhere
+    joined.Max->isThreaded = true;
+    
+    Root = joined.Root;
+    Size += right.Size + 1;
+    Current = nullptr;
+    _ends();
+    
+    right.Root = nullptr;
+    right.Size = 0;
+    right.Current = nullptr;
+    right._ends();
   }
 
   //
-  // copy constructor
+  // split:
   //
-  // NOTE: makes an exact copy of the "other" tree, such that making the
-  // copy requires no rotations.
+  // Moves every pair whose key is >= key into right, replacing what
+  // right held; this tree keeps the smaller keys.  The tree is cut
+  // along the search path for key and the pieces joined back, so the
+  // nodes are moved, not copied, when the allocator frees nodes one at
+  // a time (avlt_new_alloc).  A pooled allocator owns its nodes until
+  // it is released, though, so the smaller of the two sides is then
+  // copied into a pool of its own and the originals freed.
   //
-  avlt (const avlt& other)
-  {
-    Root = nullptr; 
-	clear();
-	_copy(other.Root);
-	this->Size = other.Size;
-  }
-
-	//
-  // destructor:
+  // Counting the keys on each side takes a walk over the smaller side,
+  // except with OrderStats, where subtree sizes give it at once.
   //
-  // Called automatically by system when tree is about to be destroyed;
-  // this is our last chance to free any resources / memory used by
-  // this tree.
+  // Time complexity:  O(lgN) with avlt_new_alloc and OrderStats,
+  //                   otherwise O(lgN + M), where M is the # of keys on
+  //                   the smaller side
   //
-  virtual ~avlt()
+  void split(const KeyT& key, avlt& right)
   {
-    clear();
+    if(this == &right)
+      throw invalid_argument("avlt::split: cannot split into the same tree");
+    
+    right.clear();
+    
+    SPLIT s = _cut(SUB{Root, Last}, key);
+    SUB   less = s.Less;
+    SUB   greater = s.Greater;
+    
+    if(s.Found != nullptr)  // key goes right, as its smallest key
+      greater = _join(SUB{nullptr, nullptr}, s.Found, greater);
+    
+    if(less.Root != nullptr)  // Thread both last nodes to nowhere
+    {
+      less.Max->Right = nullptr;
+      less.Max->isThreaded = true;
+    }
+    if(greater.Root != nullptr)
+    {
+      greater.Max->Right = nullptr;
+      greater.Max->isThreaded = true;
+    }
+    
+    int nLess;  // # of keys on each side
+    
+    if constexpr (OrderStats)
+      nLess = _count(less.Root);
+    else  // Walk both sides in step until one runs out
+    {
+      NODE* l = _begin(less.Root);
+      NODE* g = _begin(greater.Root);
+      int   steps = 0;
+      
+      while(l != nullptr && g != nullptr)
+      {
+        l = _next(l);
+        g = _next(g);
+        steps++;
+      }
+      
+      nLess = (l == nullptr) ? steps : Size - steps;
+    }
+    
+    int nGreater = Size - nLess;
+    
+    Root = less.Root;
+    Size = nLess;
+    right.Root = greater.Root;
+    right.Size = nGreater;
+    
+    if constexpr (NodeAlloc<NODE>::releases_all)
+    {
+      /* Copy the smaller side into right's (empty) pool, swapping
+       * pools first when it's this side that is smaller */
+      bool  small = nLess < nGreater;
+      avlt& copy = small ? *this : right;
+      
+      if(small)
+        Alloc.swap(right.Alloc);
+      
+      NODE* original = copy.Root;
+      
+      try
+      {
+        copy.Root = _clone(original, nullptr, small ? Alloc : right.Alloc);
+      }
+      catch(...)  // Out of memory, put the tree back together:
+      {
+        if(small)
+          Alloc.swap(right.Alloc);
+        
+        SUB whole = _join2(SUB{less.Root, less.Max}, SUB{greater.Root, greater.Max});
+        Root = whole.Root;
+        Size = nLess + nGreater;
+        right.Root = nullptr;
+        right.Size = 0;
+        right._ends();
+        _ends();
+        throw;
+      }
+      
+      copy._stats().allocated(copy.Size);
+      (small ? right : *this)._discard(original);
+    }
+    
+    Current = nullptr;
+    _ends();
+    right.Current = nullptr;
+    right._ends();
   }
 
   //
-  // operator=
+  // unite / intersect / subtract:
   //
-  // Clears "this" tree and then makes a copy of the "other" tree.
+  // Makes this tree the union, intersection or difference (this minus
+  // other) of itself and other, and leaves other empty.  Where a key is
+  // in both trees, this tree's value is the one kept.  The result is
+  // built out of the nodes of the two trees with joins and splits, so
+  // nothing is copied and no node is rebalanced twice: merging a small
+  // tree into a big one costs about what inserting its keys would, and
+  // two big trees are merged in linear time.  other's allocator is
+  // taken over as a whole, just like in join.
   //
-  // NOTE: makes an exact copy of the "other" tree, such that making the
-  // copy requires no rotations.
+  // Subtrees on both sides of each split are independent, so for big
+  // trees they are handed to up to "threads" threads (the calling
+  // thread included); a thread that runs out of work goes back to take
+  // up the next big subtree that comes along.  Comparisons of keys
+  // must not throw.
   //
-  avlt& operator=(const avlt& other)
+  // Time complexity:  O(M lg(N/M + 1)), where M <= N are the sizes of
+  //                   the two trees; divided by up to "threads" for big
+  //                   trees
+  //
+  void unite(avlt& other, int threads = (int)thread::hardware_concurrency())
   {
-    clear();
-	_copy(other.Root);
-	 
-    return *this;
+    _setOps(SetUnion, other, threads);
   }
 
-  //
-  // clear:
-  //
-  // Clears the contents of the tree, resetting the tree to empty.
-  //
-  void clear()
+  void intersect(avlt& other, int threads = (int)thread::hardware_concurrency())
   {
-    _clear(Root);
-	Root = nullptr;
-	Size = 0;
+    _setOps(SetIntersection, other, threads);
+  }
+
+  void subtract(avlt& other, int threads = (int)thread::hardware_concurrency())
+  {
+    _setOps(SetDifference, other, threads);
   }
 
   // 
@@ -456,6 +3241,39 @@ public:
       return Root->Height; // Tree Height
   }
 
+  //
+  // stats:
+  //
+  // Returns the counters kept by the statistics policy since the tree
+  // was made or reset_stats() was last called; all zero with the
+  // default avlt_no_stats.  Depth[d] of the snapshot is a histogram of
+  // search and insert path lengths.
+  //
+  // Example:
+  //    avlt<int, int, avlt_pool, false, avlt_stats> tree;
+  //    ...
+  //    avlt_stats_snapshot s = tree.stats();
+  //    cout << (double)s.SearchComparisons / s.Searches << endl;
+  //
+  // Time complexity:  O(1)
+  //
+  avlt_stats_snapshot stats() const
+  {
+    return _stats().snapshot();
+  }
+
+  //
+  // reset_stats:
+  //
+  // Zeroes the statistics counters.
+  //
+  // Time complexity:  O(1)
+  //
+  void reset_stats()
+  {
+    _stats().reset();
+  }
+
   // 
   // search:
   //
@@ -465,41 +3283,136 @@ public:
   //
   // Time complexity:  O(lgN) worst-case
   //
-  bool search(KeyT key, ValueT& value) const
+  template<typename K, _lookup<K> = 0>
+  bool search(const K& key, ValueT& value) const
   {
-    NODE* cur = Root; // Current Node
+    NODE* cur = _find(key); // Node holding key
 
-	/* Loop through the tree */
-    while (cur != nullptr)
-	{
-      if (key == cur->Key) 
-	  {
-		value = cur->Value; // Update value
-		return true; // key and value pair found
-	  }
-		
-	  /* Check if key is less than current key */
-      if (key < cur->Key)  
-      {
-        cur = cur->Left; // Move left
-      }
-	  /* Check if key is greater than current key */
-      else
+    if (cur == nullptr)  // key and value pair not found
+      return false;
+
+    value = cur->Value; // Update value
+    return true; // key and value pair found
+  }
+
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    return search<KeyT>(key, value);
+  }
+
+  //
+  // search_batch:
+  //
+  // Looks up keys[0..n-1] at once: found[i] tells whether keys[i] is in
+  // the tree and, if so, values[i] receives its value (otherwise it is
+  // left alone).  Returns the # of keys found.
+  //
+  // Up to BatchLanes lookups are in flight together and advanced one
+  // level each in turn; after every step the next node of that lookup
+  // is prefetched, so by the time its turn comes around again the node
+  // is (ideally) in cache.  The cache misses of independent lookups
+  // overlap instead of being paid one after another, which pays off on
+  // trees much larger than the cache.
+  //
+  // Time complexity:  O(n lgN)
+  //
+  size_t search_batch(const KeyT* keys, size_t n, ValueT* values, bool* found) const
+  {
+    NODE*  cur[BatchLanes];  // node each lookup is at
+    size_t key[BatchLanes];  // index of the key each lookup is for
+    int    depth[BatchLanes];  // # of nodes each lookup looked at, for the stats
+    int    calls[BatchLanes];  // # of calls of Compare each lookup made
+    int    lanes = 0;        // # of lookups in flight
+    size_t next = 0;         // next key to start
+    size_t hits = 0;         // # of keys found
+    
+    if(Root == nullptr)  // Empty tree, nothing is found
+    {
+      for(size_t i = 0; i < n; i++)
+        found[i] = false;
+      
+      return 0;
+    }
+    
+    /* Start the first lookups, all at the root */
+    for( ; lanes < BatchLanes && next < n; lanes++)
+    {
+      cur[lanes] = Root;
+      key[lanes] = next++;
+      depth[lanes] = 0;
+      calls[lanes] = 0;
+    }
+    
+    while(lanes > 0)
+    {
+      for(int j = 0; j < lanes; )
       {
-		if(cur->isThreaded)
-		{
-			cur = nullptr;
-		}
-		else
-		{
-			cur = cur->Right; // Move Right
-		}
-		 
+        NODE*       c = cur[j];
+        const KeyT& k = keys[key[j]];
+        int         order = _compare(k, c->Key, calls[j]);
+        
+        depth[j]++;
+        
+        if(order == 0)  // Found
+        {
+          values[key[j]] = c->Value;
+          found[key[j]] = true;
+          hits++;
+          c = nullptr;
+        }
+        else
+        {
+          c = (order < 0) ? c->Left : (c->isThreaded ? nullptr : c->Right);
+          
+          if(c == nullptr)  // Fell out of the tree
+            found[key[j]] = false;
+        }
+        
+        if(c != nullptr)  // Still searching, fetch the next node
+        {
+          _prefetch(c);
+          cur[j++] = c;
+          continue;
+        }
+        
+        _stats().searched(depth[j], calls[j]);
+        
+        if(next < n)  // Done, start the next key in this lane
+        {
+          cur[j] = Root;
+          key[j] = next++;
+          depth[j] = 0;
+          calls[j++] = 0;
+        }
+        else  // Done and nothing left, close the lane
+        {
+          lanes--;
+          cur[j] = cur[lanes];
+          key[j] = key[lanes];
+          depth[j] = depth[lanes];
+          calls[j] = calls[lanes];
+        }
       }
-	} 
-  
-    // key and value pair not found
-    return false;
+    }
+    
+    return hits;
+  }
+
+  //
+  // search_batch (vectors):
+  //
+  // Same as above; values and found are resized to keys.size().
+  //
+  size_t search_batch(const vector<KeyT>& keys, vector<ValueT>& values, vector<bool>& found) const
+  {
+    size_t n = keys.size();
+    unique_ptr<bool[]> hit(new bool[n]);
+    
+    values.resize(n);
+    size_t hits = search_batch(keys.data(), n, values.data(), hit.get());
+    
+    found.assign(hit.get(), hit.get() + n);
+    return hits;
   }
 
   //
@@ -516,57 +3429,159 @@ public:
   // that fall within the range.  That would be O(N), and thus invalid.
   // Be smarter, you have the technology.
   //
-  vector<KeyT> range_search(KeyT lower, KeyT upper)
+  template<typename K, _lookup<K> = 0>
+  vector<KeyT> range_search(const K& lower, const K& upper) const
   {
     vector<KeyT>  keys;    // Vector of keys
-	NODE* cur = Root;      // Current Node
-	NODE* prev = nullptr;  // Previous Node
 	
-	if(lower > upper)  // Invalid bounds return default:
+	if(_less(upper, lower))  // Invalid bounds return default:
 	{
 		return keys;
 	}
 	
-	// Searches for the lower key in the tree:
-	while(cur != nullptr)
-	{
- 		prev = cur;  // Update previous node
-		
-		if(cur->Key == lower)  // lower found:
-			break;
-		
-		if(lower < cur->Key)  // Lower is to the left:
-		{
-			cur = cur->Left;  
-		}
-		else  // Lower is to the right:
-		{
-			if(cur->isThreaded)
-				break;
-			else
-				cur = cur->Right;
-		}
-			
-	} // end while
-	
-	// Loop until upper is found:
-	while(prev != nullptr && prev->Key <= upper)
+	// Find lower, then follow the threads until past upper:
+	_scan(_lowerBound(lower), upper, true, [&](const KeyT& key, const ValueT&)
 	{
-		// Key in range, push to vector:
-		if(lower <= prev->Key)  
-			keys.push_back(prev->Key);
-		
-		if(prev->isThreaded)
-			prev = prev->Right;
-		else  
-			// Get to the right node and retrieve leftmost node:
-			prev = _begin(prev->Right);
-
-	}
+		keys.push_back(key);
+	});
 
 	return keys;
   }
 
+  vector<KeyT> range_search(const KeyT& lower, const KeyT& upper) const
+  {
+    return range_search<KeyT>(lower, upper);
+  }
+
+  //
+  // range_search (output iterator)
+  //
+  // Writes the (key, value) pairs in the range [lower..upper], inclusive,
+  // to "out" in ascending order, as pair<KeyT, ValueT>, stopping after
+  // "limit" pairs.  Nothing is allocated by the tree.  Returns the # of
+  // pairs written.
+  //
+  // Time complexity: O(lgN + M), where M is the # of pairs written
+  //
+  template<typename OutputIt>
+  size_t range_search(const KeyT& lower, const KeyT& upper, OutputIt out,
+                      size_t limit = (size_t)-1) const
+  {
+    if(_less(upper, lower) || limit == 0)  // Invalid bounds or nothing wanted
+      return 0;
+    
+    return _scan(_lowerBound(lower), upper, true, [&](const KeyT& key, const ValueT& value)
+    {
+      *out = pair<KeyT, ValueT>(key, value);
+      ++out;
+      return --limit > 0;
+    });
+  }
+
+  //
+  // range_for_each
+  //
+  // Calls visit(key, value) for every pair in the range [lower..upper],
+  // inclusive, in ascending order.  A visitor that returns bool stops
+  // the scan by returning false; one that returns void sees the whole
+  // range.  The scan descends the tree once to find lower and then
+  // follows the threads, without allocating.  Returns the # of pairs
+  // visited.
+  //
+  // Example usage:
+  //    tree.range_for_each(10, 20, [&](const int& key, const string& value)
+  //    {
+  //      cout << key << ": " << value << endl;
+  //      return key != 15;  // stop after 15
+  //    });
+  //
+  // Time complexity: O(lgN + M), where M is the # of pairs visited
+  //
+  template<typename K, typename Visitor, _lookup<K> = 0>
+  size_t range_for_each(const K& lower, const K& upper, Visitor visit) const
+  {
+    if(_less(upper, lower))  // Invalid bounds
+      return 0;
+    
+    return _scan(_lowerBound(lower), upper, true, visit);
+  }
+
+  template<typename Visitor>
+  size_t range_for_each(const KeyT& lower, const KeyT& upper, Visitor visit) const
+  {
+    return range_for_each<KeyT, Visitor>(lower, upper, visit);
+  }
+
+  //
+  // range_for_each_open
+  //
+  // Same as range_for_each, but over the half-open range [lower..upper),
+  // so consecutive pages can share their boundary key.
+  //
+  // Time complexity: O(lgN + M), where M is the # of pairs visited
+  //
+  template<typename Visitor>
+  size_t range_for_each_open(const KeyT& lower, const KeyT& upper, Visitor visit) const
+  {
+    if(!_less(lower, upper))  // Empty range
+      return 0;
+    
+    return _scan(_lowerBound(lower), upper, false, visit);
+  }
+
+  //
+  // range_for_each_reverse
+  //
+  // Same as range_for_each, but visits the range [lower..upper] in
+  // descending order.  There are no left threads, so the nodes still to
+  // visit are kept on a fixed-size stack bounded by the tree height.
+  //
+  // Time complexity: O(lgN + M), where M is the # of pairs visited
+  //
+  template<typename Visitor>
+  size_t range_for_each_reverse(const KeyT& lower, const KeyT& upper, Visitor visit) const
+  {
+    NODE*  nodes[MaxHeight + 1];  // Ancestors whose key is <= upper, nearest on top
+    int    top = 0;
+    size_t count = 0;             // # of nodes visited
+    
+    if(_less(upper, lower))  // Invalid bounds
+      return 0;
+    
+    /* Push the path of nodes <= upper, going as far right as possible */
+    auto descend = [&](NODE* cur)
+    {
+      while(cur != nullptr)
+      {
+        if(_less(upper, cur->Key))  // Too big, go left
+          cur = cur->Left;
+        else
+        {
+          nodes[top++] = cur;
+          cur = (cur->isThreaded) ? nullptr : cur->Right;
+        }
+      }
+    };
+    
+    descend(Root);
+    
+    while(top > 0)
+    {
+      NODE* cur = nodes[--top];  // Largest key not visited yet
+      
+      if(_less(cur->Key, lower))  // Past lower, done
+        break;
+      
+      count++;
+      if(!_visit(visit, cur))  // Visitor is done
+        break;
+      
+      descend(cur->Left);  // Predecessors are in the left subtree
+    }
+    
+    return count;
+  }
+
   //
   // insert
   //
@@ -576,142 +3591,207 @@ public:
   //
   // Time complexity:  O(lgN) worst-case
   //
-  void insert(KeyT key, ValueT value)
+  void insert(const KeyT& key, const ValueT& value)
+  {
+    _tryEmplace(key, value);
+  }
+
+  void insert(KeyT&& key, ValueT&& value)
+  {
+    _tryEmplace(std::move(key), std::move(value));
+  }
+
+  //
+  // try_emplace
+  //
+  // Inserts key with a value constructed in place inside the new node
+  // from args, returning true.  If the key is already in the tree,
+  // nothing is constructed (args are not moved from) and false is
+  // returned.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  template<typename... Args>
+  bool try_emplace(const KeyT& key, Args&&... args)
+  {
+    return _tryEmplace(key, std::forward<Args>(args)...);
+  }
+
+  template<typename... Args>
+  bool try_emplace(KeyT&& key, Args&&... args)
+  {
+    return _tryEmplace(std::move(key), std::forward<Args>(args)...);
+  }
+
+  //
+  // emplace
+  //
+  // Builds a node with the key constructed from "key" and the value
+  // from args, both in place, then inserts it and returns true.  If an
+  // equal key is already in the tree, the node is destroyed and false
+  // is returned.  Prefer try_emplace when the key can be compared as is.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  template<typename K, typename... Args>
+  bool emplace(K&& key, Args&&... args)
+  {
+    NODE* newNode = _newNode(std::forward<K>(key), std::forward<Args>(args)...);
+    NODE* path[MaxHeight + 1];
+    int   top = 0;
+    NODE* prev;
+    int   comparisons = 0;
+    
+    bool found = (_searchPath(newNode->Key, path, top, prev, comparisons) != nullptr);
+    
+    _stats().inserted(top + found, comparisons);
+    
+    if(found)  // Key already in tree
+    {
+      _freeNode(newNode);
+      return false;
+    }
+    
+    _link(newNode, prev, path, top);
+    return true;
+  }
+
+  //
+  // push_back
+  //
+  // Inserts the given key like insert, tuned for keys that keep growing
+  // (timestamps, sequence numbers).  The tree caches its right spine,
+  // so a key greater than every key in the tree is linked below the
+  // rightmost node without searching; rebalancing after such appends
+  // is constant on average.  A key that is not the largest resumes its
+  // search from the deepest spine node with a smaller key, so keys a
+  // little out of order stay cheap too.
+  //
+  // Time complexity:  O(1) amortized for appends, O(lgN) worst-case
+  //
+  void push_back(const KeyT& key, const ValueT& value)
   {
-    NODE* prev = nullptr; // Previous Node
-    NODE* cur = Root; // Current Node
-	stack<NODE*> nodes; // Declare stack of nodes to check heights
+    _insertNear(key, value);
+  }
 
-    /* Search to see if tree already contains key */
-    while (cur != nullptr)
+  //
+  // erase
+  //
+  // Removes the given key (and its value) from the tree, returning true
+  // if it was found and false if not.  Threads are repaired and
+  // rotations are performed as necessary to keep the tree balanced
+  // according to AVL definition.  If the internal begin()/next() state
+  // points at the erased key, it moves on to the next inorder key.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  bool erase(const KeyT& key)
+  {
+    NODE* path[MaxHeight + 1];  // Nodes from the root down to the erased node's parent
+    int   top = 0;              // # of nodes on the path
+    NODE* parent;               // Parent of erased node
+    int   comparisons = 0;      // # of calls of Compare, for the stats
+    
+    /* Search for the key, remembering the path */
+    NODE* cur = _searchPath(key, path, top, parent, comparisons);
+    
+    _stats().erased(top + (cur != nullptr), comparisons);
+    
+    if(cur == nullptr)  // Key not in tree
+      return false;
+    
+    NODE* repl;  // Node taking the erased node's place
+    
+    /* Keep begin()/next() valid */
+    if(Current == cur)
+      Current = _next(cur);
+    
+    if(cur->Left == nullptr)  // At most a right child moves up:
     {
-      if (key == cur->Key)  // Key already in tree
-        return;
-		
-	  nodes.push(cur); // stack so we can return later
-		
-      if (key < cur->Key)  // Search left
+      repl = (cur->isThreaded) ? nullptr : cur->Right;
+    }
+    else if(cur->isThreaded)  // Only a left child, it moves up:
+    {
+      repl = cur->Left;
+      
+      /* The predecessor threaded to cur, thread it past cur */
+      NODE* pred = repl;
+      while(!pred->isThreaded)
+        pred = pred->Right;
+      
+      pred->Right = cur->Right;
+    }
+    else  // Two children, the inorder successor moves up:
+    {
+      int slot = top++;  // Successor takes cur's place on the path
+      
+      repl = cur->Right;
+      while(repl->Left != nullptr)
       {
-        prev = cur;
-        cur = cur->Left;
+        path[top++] = repl;
+        repl = repl->Left;
       }
-      else // Search right
-      {
-		  prev = cur;
-		  if(cur->isThreaded)
-		  {
-			  cur = nullptr;
-		  }
-		  else // Not Threaded
-		  {   
-			  cur = cur->Right; // Move right
-		  }
-       }
-    }//while
-
-	/* Key is not in tree, so a new 
-	 * node is allocated to insert */
-      NODE* newNode = new NODE();
-	  newNode->Key = key;
-	  newNode->Value = value;
-      newNode->Left = nullptr;
-      newNode->Right = nullptr;
-	  newNode->isThreaded = true;
-	  newNode->Height = 0;
-	  
-    //
-    // NOTE: cur is null, and prev denotes node where
-    // we fell out of the tree.  if prev is null, then
-    // the tree is empty and the Root pointer needs 
-    // to be updated.
-    //
-
-      if(prev == nullptr)
-         Root = newNode;
-      else if (key < prev->Key)
-	  {
-		  prev->Left = newNode; // Insert new node to the left of the previous
-		  newNode->Right = prev; // Point new node's right pointer 
-								 // to the node on the right
-	  }
-      else
-	  {   
-		  newNode->Right = prev->Right;
-		  prev->isThreaded = false; 
-		  prev->Right = newNode; // Insert new node to the right of the previous
-	  }
-         
-      Size++; // Update Size
-	  
-	 // Walk back up tree using stack and update heights:
-	  while (!nodes.empty())
+      
+      /* Unlink the successor from its parent when it's deeper down */
+      if(top > slot + 1)
       {
-		 NODE* parent;      // Parent of the current node
-		 cur = nodes.top(); // Make current top of stack
-		 nodes.pop();       // Pop the stack
-		 
-		 if(nodes.empty()) // Stack empty no parent:
-		 {
-			 parent = nullptr;
-		 }
-		 else // Parent found:
-		 {
-			 parent = nodes.top();
-		 }
-		 
-		 /* Get the left and right heights and of the node and calculate total height */
-		 int hL = (cur->Left == nullptr) ? -1 : cur->Left->Height;
-		 int hR = (cur->Right == nullptr || cur->isThreaded) ? -1 : cur->Right->Height; 
-		 int hCur = 1 + max(hL, hR);
-
-		 if (cur->Height == hCur)  // didn't change, so no need to go further:
-			break;
-		 else if(abs(hL - hR) <= 1)  // height changed, update and keep going:
-			cur->Height = hCur;
-		 else  // Height is broken:
-         {
-			 if(hL > hR)  // Check if cur->Left is leaning:
-			 {
-				 NODE* L =  cur->Left;  // Get left node of current
-
-				 /* Get the left and right heights of L */
-				 int hLL = (L->Left == nullptr) ? -1 : L->Left->Height;
-		         int hLR = (L->Right == nullptr || L->isThreaded) ? -1 : L->Right->Height; // check for threading
-			
-				 if(hLL > hLR) // Case 1
-				 {
-					_RightRotate(parent,cur);
-				 }
-				 else // Case 2
-				 {
-					_LeftRotate(cur,cur->Left);  // Rotate left
-					_RightRotate(parent,cur);    // Rotate right
-				 }
-			 }
-			 else if(hR > hL) // Check if cur->Right is leaning:
-			 {
-				 NODE* R = cur->Right;  // Get right node of current
-		
-				 /* Get the left and right heights of L */ 
-				 int hRR = (R->Right == nullptr || R->isThreaded) ? -1 : R->Right->Height;
-		         int hRL = (R->Left == nullptr) ? -1 : R->Left->Height; 
-				 
-				 if(hRR > hRL) // Case 4
-				 {
-					 _LeftRotate(parent,cur);  // Rotate left
-				 }
-				 else // Case 3
-				 {
-					 _RightRotate(cur,cur->Right);  // Rotate right
-					 _LeftRotate(parent,cur);       // Rotate left
-				 }
-			 }  // end of else if
-			
-         }  // end of else
-			 
-      }  // end while
-		 
-  }  // end of insert
+        path[top - 1]->Left = (repl->isThreaded) ? nullptr : repl->Right;
+        repl->Right = cur->Right;
+        repl->isThreaded = false;
+      }
+      
+      /* The predecessor threaded to cur, thread it to the successor */
+      NODE* pred = cur->Left;
+      while(!pred->isThreaded)
+        pred = pred->Right;
+      
+      pred->Right = repl;
+      
+      repl->Left = cur->Left;
+      repl->Height = cur->Height;  // Fixed up by the rebalance below
+      if constexpr (OrderStats)
+        repl->Count = cur->Count;  // Lowered with the rest of the path below
+      path[slot] = repl;
+    }
+    
+    /* Relink cur's parent to the replacement */
+    if(parent == nullptr)
+      Root = repl;
+    else if(parent->Left == cur)
+      parent->Left = repl;
+    else if(repl == nullptr)  // Parent now threads to cur's successor
+    {
+      parent->Right = cur->Right;
+      parent->isThreaded = true;
+    }
+    else
+      parent->Right = repl;
+    
+    /* Find the new leftmost or rightmost node if cur was one */
+    bool wasEnd = (cur == First || cur == Last);
+    
+    _freeNode(cur);
+    Size--;  // Update Size
+    
+    /* Every node on the path lost one descendant */
+    if constexpr (OrderStats)
+    {
+      for(int i = 0; i < top; i++)
+        path[i]->Count--;
+    }
+    
+    _rebalance(path, top);
+    
+    if(wasEnd)
+      _ends();
+    else
+    {
+      SpineTop = -1;  // Rotations may move the right spine
+      FingerTop = 0;
+    }
+    
+    return true;
+  }
 	   
 	
   //
@@ -722,13 +3802,14 @@ public:
   //
   // Time complexity:  O(lgN) worst-case
   //
-  ValueT operator[](KeyT key) const
+  template<typename K, _lookup<K> = 0>
+  ValueT operator[](const K& key) const
   {
-    ValueT value; // Declare local value to call search and update
+    NODE* cur = _find(key); // Node holding key
 	  
-    if(search(key,value))  // Key found, return value:
+    if(cur != nullptr)  // Key found, return value:
 	{
-		return value; 
+		return cur->Value; 
 	}
 	else  // Key not found, return default:
 	{
@@ -736,6 +3817,11 @@ public:
 	}
   }
 
+  ValueT operator[](const KeyT& key) const
+  {
+    return operator[]<KeyT>(key);
+  }
+
   //
   // 
   //
@@ -749,20 +3835,23 @@ public:
   //
   // Time complexity:  O(lgN) worst-case
   //
-  KeyT operator()(KeyT key) const
+  template<typename K, _lookup<K> = 0>
+  KeyT operator()(const K& key) const
   {
     NODE* cur = Root;
 	
 	/* Search through tree */
 	while(cur != nullptr)
 	{
+		int order = _compare(key, cur->Key);
+		
 		/* Key found, return right node's key */
-		if(key == cur->Key && cur->Right != nullptr)
+		if(order == 0 && cur->Right != nullptr)
 		{
 			return cur->Right->Key;
 		}
 		
-		if(key < cur->Key)
+		if(order < 0)
 		{
 			cur = cur->Left; // Go Left
 		}
@@ -783,6 +3872,11 @@ public:
     return KeyT{ };
   }
 
+  KeyT operator()(const KeyT& key) const
+  {
+    return operator()<KeyT>(key);
+  }
+
   //
   // %
   //
@@ -793,39 +3887,20 @@ public:
   //
   // Time complexity:  O(lgN) worst-case
   //
-  int operator%(KeyT key) const
+  template<typename K, _lookup<K> = 0>
+  int operator%(const K& key) const
   {
-	NODE* cur = Root;
+	NODE* cur = _find(key); // Node holding key
 	
-	/* Loop through the tree */
-	while (cur != nullptr)
-	{
-      if (key == cur->Key) 
-	  {
-		return cur->Height; // Key found return height
-	  }
-		
-	  /* Check if key is less than current key */
-      if (key < cur->Key)  
-      {
-        cur = cur->Left; // Move left
-      }
-	  /* Check if key is greater than current key */
-      else
-      {
-		if(cur->isThreaded)
-		{
-			cur = nullptr;
-		}
-		else
-		{
-			cur = cur->Right; // Move Right
-		}
-		 
-      }
-	} 
+	if (cur == nullptr)  // Key not found
+		return -1;
+	
+	return cur->Height; // Key found return height
+  }
 
-    return -1;
+  int operator%(const KeyT& key) const
+  {
+    return operator%<KeyT>(key);
   }
 
   //
@@ -837,7 +3912,7 @@ public:
   // the first inorder key.
   //
   // Space complexity: O(1)
-  // Time complexity:  O(lgN) worst-case
+  // Time complexity:  O(1), the leftmost node is cached
   //
   // Example usage:
   //    tree.begin();
@@ -846,8 +3921,8 @@ public:
   //
   void begin()
   {
-    Current = _begin(Root); // Initialize Current
-							// to leftmost node
+    Current = First; // Initialize Current
+					 // to leftmost node
   }
 
   //
@@ -872,27 +3947,435 @@ public:
   //
   bool next(KeyT& key)
   {
-    if(Current != nullptr)
-	{
-	    if(Current->isThreaded)
-		{
-			key = Current->Key; // Update key
-			Current = Current->Right; // Go right
-			return true;
-		}
-		
-	    if(!Current->isThreaded)
-		{
-			key = Current->Key; // Update key
-			
-			/* Get leftmost node of the
-			 * current node's right node */
-			Current = _begin(Current->Right);
-			return true;
-		}
-	}
-	 
-	 return false;
+    if(Current == nullptr)  // End of the traversal
+      return false;
+    
+    key = Current->Key;        // Update key
+    
+    if(Current->isThreaded && Current->Right != nullptr)
+      _stats().hopped();
+    
+    Current = _next(Current);  // Advance to the next inorder node
+    return true;
+  }
+
+  //
+  // const_iterator
+  //
+  // Forward iterator over the (key, value) pairs in inorder.  All of its
+  // state lives in the iterator itself (one node pointer), and it only
+  // follows the right threads, so incrementing is O(1) amortized with no
+  // stack.  Any number of iterators, on any number of threads, may walk
+  // the same tree at once as long as nothing modifies the tree.  An
+  // iterator stays valid until its node is erased or the tree is
+  // cleared.
+  //
+  // Dereferencing yields a pair of references to the key and value.
+  //
+  // Example usage:
+  //    for (auto it = tree.cbegin(); it != tree.cend(); ++it)
+  //      cout << it.key() << ": " << it.value() << endl;
+  //
+  class const_iterator
+  {
+  private:
+    friend class avlt;
+    
+    NODE* Cur;  // node at the current position, nullptr at the end
+    
+    explicit const_iterator(NODE* cur) : Cur(cur) { }
+    
+  public:
+    using iterator_category = forward_iterator_tag;
+    using value_type        = pair<KeyT, ValueT>;
+    using difference_type   = ptrdiff_t;
+    using reference         = pair<const KeyT&, const ValueT&>;
+    using pointer           = void;
+    
+    const_iterator() : Cur(nullptr) { }
+    
+    const KeyT& key() const
+    {
+      return Cur->Key;
+    }
+    
+    const ValueT& value() const
+    {
+      return Cur->Value;
+    }
+    
+    reference operator*() const
+    {
+      return reference(Cur->Key, Cur->Value);
+    }
+    
+    const_iterator& operator++()
+    {
+      Cur = _next(Cur);
+      return *this;
+    }
+    
+    const_iterator operator++(int)
+    {
+      const_iterator old = *this;
+      Cur = _next(Cur);
+      return old;
+    }
+    
+    bool operator==(const const_iterator& other) const
+    {
+      return Cur == other.Cur;
+    }
+    
+    bool operator!=(const const_iterator& other) const
+    {
+      return Cur != other.Cur;
+    }
+  };
+
+  //
+  // cbegin / cend
+  //
+  // Iterators to the first inorder pair and one past the last.  The
+  // const overloads of begin() and end() do the same, so a const tree
+  // works in a range-based for loop:
+  //
+  //    const avlt<int, int>& ctree = tree;
+  //    for (auto kv : ctree)
+  //      cout << kv.first << endl;
+  //
+  // Time complexity:  O(1), the leftmost node is cached
+  //
+  const_iterator cbegin() const
+  {
+    return const_iterator(First);
+  }
+
+  const_iterator cend() const
+  {
+    return const_iterator(nullptr);
+  }
+
+  const_iterator begin() const
+  {
+    return cbegin();
+  }
+
+  const_iterator end() const
+  {
+    return cend();
+  }
+
+  //
+  // find
+  //
+  // Returns an iterator to the given key, or cend() if not found.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  template<typename K, _lookup<K> = 0>
+  const_iterator find(const K& key) const
+  {
+    return const_iterator(_find(key));
+  }
+
+  const_iterator find(const KeyT& key) const
+  {
+    return find<KeyT>(key);
+  }
+
+  //
+  // lower_bound / upper_bound
+  //
+  // Iterator to the first key not less than (lower_bound) or greater
+  // than (upper_bound) the given key, or cend() if there is none.
+  // Together with the const iterators these give open-ended scans:
+  //
+  //    for (auto it = tree.lower_bound(lo); it != tree.cend(); ++it)
+  //      ...
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  template<typename K, _lookup<K> = 0>
+  const_iterator lower_bound(const K& key) const
+  {
+    return const_iterator(_lowerBound(key));
+  }
+
+  const_iterator lower_bound(const KeyT& key) const
+  {
+    return lower_bound<KeyT>(key);
+  }
+
+  template<typename K, _lookup<K> = 0>
+  const_iterator upper_bound(const K& key) const
+  {
+    return const_iterator(_upperBound(key));
+  }
+
+  const_iterator upper_bound(const KeyT& key) const
+  {
+    return upper_bound<KeyT>(key);
+  }
+
+  //
+  // insert_hint
+  //
+  // Inserts the given key like insert and returns an iterator to it
+  // (or to the pair already holding it).  As with std::map, hint is the
+  // position the key is expected to land just before.  Nodes have no
+  // parent pointers, so the tree keeps the search path of the last key
+  // insert_hint looked up.  A hint on that path, such as the iterator
+  // the last call returned or the same hint again, starts the search
+  // from the bottom of the path: it climbs only while the key lies
+  // outside the subtree at hand, then goes down, so a hint right next
+  // to the last key costs a few comparisons however big the tree.  Any
+  // other hint starts at the root, and any other update forgets the
+  // path.  A hint of cend() is inserted as by push_back.
+  //
+  // Time complexity:  O(1) amortized for keys next to the last one,
+  // O(lgN) worst-case
+  //
+  const_iterator insert_hint(const_iterator hint, const KeyT& key, const ValueT& value)
+  {
+    if(hint == cend())  // At the end, as push_back
+      return const_iterator(_insertNear(key, value));
+    
+    return const_iterator(_insertHint(hint.Cur, key, value));
+  }
+
+  //
+  // rank
+  //
+  // Returns the # of keys in the tree that are less than the given key
+  // (its 0-based position if it is in the tree).  Requires OrderStats.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  template<typename K, _lookup<K> = 0>
+  int rank(const K& key) const
+  {
+    static_assert(OrderStats, "rank() needs avlt<..., OrderStats = true>");
+    
+    return _rank(key, false);
+  }
+
+  int rank(const KeyT& key) const
+  {
+    return rank<KeyT>(key);
+  }
+
+  //
+  // select
+  //
+  // Returns an iterator to the k-th smallest key (0-based), or cend()
+  // if k is not in [0..size()-1].  Requires OrderStats.
+  //
+  // Example:  percentile p is tree.select(p * (tree.size() - 1) / 100)
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  const_iterator select(int k) const
+  {
+    static_assert(OrderStats, "select() needs avlt<..., OrderStats = true>");
+    
+    NODE* cur = Root;  // Current Node
+    
+    if(k < 0 || k >= Size)  // Out of range
+      return cend();
+    
+    while(cur != nullptr)
+    {
+      int nL = _count(cur->Left);  // # of keys smaller than cur in its subtree
+      
+      if(k == nL)  // Found
+        break;
+      
+      if(k < nL)  // In the left subtree
+        cur = cur->Left;
+      else  // In the right subtree, skip the left and cur
+      {
+        k -= nL + 1;
+        cur = cur->Right;
+      }
+    }
+    
+    return const_iterator(cur);
+  }
+
+  //
+  // count_range
+  //
+  // Returns the # of keys in the range [lower..upper], inclusive, without
+  // visiting them.  Requires OrderStats.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  template<typename K, _lookup<K> = 0>
+  int count_range(const K& lower, const K& upper) const
+  {
+    static_assert(OrderStats, "count_range() needs avlt<..., OrderStats = true>");
+    
+    if(_less(upper, lower))  // Invalid bounds
+      return 0;
+    
+    return _rank(upper, true) - _rank(lower, false);
+  }
+
+  int count_range(const KeyT& lower, const KeyT& upper) const
+  {
+    return count_range<KeyT>(lower, upper);
+  }
+
+  //
+  // save:
+  //
+  // Writes the tree to a binary image file: a header (see
+  // avlt_image_header), then the pairs in key order, encoded by the
+  // codecs (see avlt_codec).  With fixed-size keys and values the image
+  // holds a key array and a value array, which avlt_image can map and
+  // search without loading.  The file is written under a temporary name
+  // and renamed into place, so a crash never leaves a torn image behind.
+  // Throws runtime_error if the file cannot be written.
+  //
+  // Time complexity:  O(N)
+  //
+  template<typename KeyCodec = avlt_codec<KeyT>, typename ValueCodec = avlt_codec<ValueT>>
+  void save(const string& path) const
+  {
+    avlt_image_header header =
+      avlt_image_header::make(KeyCodec::fixed_size, ValueCodec::fixed_size, (uint64_t)Size);
+    string temp = path + ".tmp";
+    
+    {
+      vector<char> buffer(1 << 20);  // Few large writes instead of one per pair
+      ofstream     out;
+      out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+      out.open(temp, ios::binary | ios::trunc);
+      if(!out)
+        throw runtime_error("avlt::save: cannot open " + temp);
+      
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      
+      if(header.ValuesOffset == 0)  // Records
+      {
+        for(NODE* cur = First; cur != nullptr; cur = _next(cur))
+        {
+          KeyCodec::write(out, cur->Key);
+          ValueCodec::write(out, cur->Value);
+        }
+      }
+      else  // Key array, then value array
+      {
+        /* Pad up to the key array */
+        while(out && (uint64_t)out.tellp() < header.KeysOffset)
+          out.put('\0');
+        
+        for(NODE* cur = First; cur != nullptr; cur = _next(cur))
+          KeyCodec::write(out, cur->Key);
+        
+        /* Pad up to the value array */
+        while(out && (uint64_t)out.tellp() < header.ValuesOffset)
+          out.put('\0');
+        
+        for(NODE* cur = First; cur != nullptr; cur = _next(cur))
+          ValueCodec::write(out, cur->Value);
+      }
+      
+      out.flush();
+      if(!out)
+      {
+        out.close();
+        remove(temp.c_str());
+        throw runtime_error("avlt::save: cannot write " + temp);
+      }
+    }
+    
+    if(rename(temp.c_str(), path.c_str()) != 0)
+    {
+      remove(temp.c_str());
+      throw runtime_error("avlt::save: cannot rename " + temp + " to " + path);
+    }
+  }
+
+  //
+  // load:
+  //
+  // Replaces the contents of the tree with an image written by save(),
+  // using the same codecs.  The pairs are stored in key order, so the
+  // tree is built perfectly balanced straight from the file, with no
+  // comparisons and no rotations.  Keys and values must be default
+  // constructible.  Throws runtime_error if the file is missing, is not
+  // an image, was written with different codecs, or is cut short; the
+  // tree is left empty then.
+  //
+  // Time complexity:  O(N)
+  //
+  template<typename KeyCodec = avlt_codec<KeyT>, typename ValueCodec = avlt_codec<ValueT>>
+  void load(const string& path)
+  {
+    clear();
+    
+    vector<char> keyBuffer(1 << 20);  // Few large reads instead of one per pair
+    ifstream     keys;
+    keys.rdbuf()->pubsetbuf(keyBuffer.data(), keyBuffer.size());
+    keys.open(path, ios::binary);
+    if(!keys)
+      throw runtime_error("avlt::load: cannot open " + path);
+    
+    avlt_image_header header;
+    keys.read(reinterpret_cast<char*>(&header), sizeof(header));
+    
+    if(!keys || !header.valid())
+      throw runtime_error("avlt::load: " + path + " is not an avlt image");
+    
+    avlt_image_header expect =
+      avlt_image_header::make(KeyCodec::fixed_size, ValueCodec::fixed_size, header.Count);
+    
+    if(header.KeyBytes != expect.KeyBytes || header.ValueBytes != expect.ValueBytes ||
+       header.KeysOffset != expect.KeysOffset || header.ValuesOffset != expect.ValuesOffset ||
+       header.Count > (uint64_t)INT32_MAX)
+      throw runtime_error("avlt::load: " + path + " does not match these key/value codecs");
+    
+    keys.seekg((streamoff)header.KeysOffset);
+    
+    int   n = (int)header.Count;
+    NODE* head;
+    
+    if(header.ValuesOffset == 0)  // Records, keys and values interleaved
+      head = _readChain<KeyCodec, ValueCodec>(keys, keys, n);
+    else  // A second stream walks the value array
+    {
+      vector<char> valueBuffer(1 << 20);
+      ifstream     values;
+      values.rdbuf()->pubsetbuf(valueBuffer.data(), valueBuffer.size());
+      values.open(path, ios::binary);
+      values.seekg((streamoff)header.ValuesOffset);
+      if(!values)
+        throw runtime_error("avlt::load: cannot open " + path);
+      
+      head = _readChain<KeyCodec, ValueCodec>(keys, values, n);
+    }
+    
+    Root = _build(head, n);
+    Size = n;
+    _ends();
+  }
+
+  //
+  // freeze
+  //
+  // Returns an immutable copy of the tree laid out for fast lookups, in
+  // one pass along the threads.  The copy does not follow later changes
+  // to the tree.  The copy orders its keys with this tree's Compare.
+  // Needs frozen_avlt.h.
+  //
+  // Time complexity:  O(N)
+  //
+  frozen_avlt<KeyT, ValueT, Compare> freeze() const
+  {
+    return frozen_avlt<KeyT, ValueT, Compare>(cbegin(), (size_t)Size,
+                                              static_cast<const Compare&>(*this));
   }
 
   //
@@ -0,0 +1,443 @@
+/*avlt_image.h*/
+
+//
+// Read-only view of an avlt image file, mapped into memory.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "avlt.h"
+
+using namespace std;
+
+//
+// avlt_image
+//
+// Serves lookups straight from a file written by avlt::save(), without
+// building a tree: the file is mapped read-only and searched in place.
+// Opening costs one mmap no matter how big the image is, and pages are
+// read in by the OS only as searches touch them, so a process can start
+// answering queries at once and several processes share one copy of
+// the data in the page cache.
+//
+// Only images of fixed-size keys and values can be mapped, which is
+// what the default avlt_codec writes for trivially copyable types: the
+// keys are one sorted array, searched by binary search, and the values
+// a parallel array.  The image must have been written on a machine with
+// the same byte order and type layout.
+//
+// Compare must order the keys the same way as the tree that saved the
+// image.
+//
+template<typename KeyT, typename ValueT, typename Compare = avlt_compare>
+class avlt_image : private Compare
+{
+  static_assert(is_trivially_copyable<KeyT>::value && is_trivially_copyable<ValueT>::value,
+                "avlt_image: keys and values must be trivially copyable");
+
+private:
+  void*         Map;     // start of the mapping, nullptr if none
+  size_t        Length;  // length of the mapping in bytes
+  const KeyT*   Keys;    // sorted keys inside the mapping
+  const ValueT* Values;  // value of Keys[i]
+  size_t        Size;    // # of pairs
+
+
+	/* true if a comes before b under Compare */
+	bool _less(const KeyT& a, const KeyT& b) const
+	{
+		return avlt_less(static_cast<const Compare&>(*this), a, b);
+	}
+
+
+	/* Returns the index of the first key not less
+	 * than key (upper => greater than key), Size if
+	 * there is none */
+	size_t _bound(const KeyT& key, bool upper) const
+	{
+		size_t low = 0;
+		size_t count = Size;
+
+		while(count > 0)
+		{
+			size_t half = count / 2;
+			bool   right = upper ? !_less(key, Keys[low + half]) : _less(Keys[low + half], key);
+
+			if(right)
+			{
+				low += half + 1;
+				count -= half + 1;
+			}
+			else
+				count = half;
+		}
+
+		return low;
+	}
+
+
+	/* Unmaps the file, if mapped */
+	void _unmap()
+	{
+		if(Map != nullptr)
+			munmap(Map, Length);
+
+		Map = nullptr;
+		Length = 0;
+		Keys = nullptr;
+		Values = nullptr;
+		Size = 0;
+	}
+
+public:
+  //
+  // default constructor:
+  //
+  // An empty view, not backed by any file.
+  //
+  explicit avlt_image(const Compare& compare = Compare())
+    : Compare(compare), Map(nullptr), Length(0), Keys(nullptr), Values(nullptr), Size(0)
+  { }
+
+  //
+  // constructor:
+  //
+  // Maps the image at path.  Throws runtime_error if it cannot be
+  // opened or mapped, is not an avlt image, is cut short, or was not
+  // written with keys of sizeof(KeyT) and values of sizeof(ValueT)
+  // bytes.  compare orders the keys.
+  //
+  // Time complexity:  O(1), pages are read in on first use
+  //
+  explicit avlt_image(const string& path, const Compare& compare = Compare())
+    : avlt_image(compare)
+  {
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+      throw runtime_error("avlt_image: cannot open " + path);
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(avlt_image_header))
+    {
+      close(fd);
+      throw runtime_error("avlt_image: " + path + " is not an avlt image");
+    }
+
+    Length = (size_t)st.st_size;
+    Map = mmap(nullptr, Length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // The mapping keeps the file open
+
+    if(Map == MAP_FAILED)
+    {
+      Map = nullptr;
+      Length = 0;
+      throw runtime_error("avlt_image: cannot map " + path);
+    }
+
+    const avlt_image_header* header = static_cast<const avlt_image_header*>(Map);
+
+    if(!header->valid())
+    {
+      _unmap();
+      throw runtime_error("avlt_image: " + path + " is not an avlt image");
+    }
+
+    /* Bound the count before any offset is computed from it, so
+     * a corrupt count cannot wrap around and pass the checks */
+    uint64_t keysOffset = avlt_image_header::make(sizeof(KeyT), sizeof(ValueT), 0).KeysOffset;
+    uint64_t room = (Length < keysOffset) ? 0 : (Length - keysOffset) / (sizeof(KeyT) + sizeof(ValueT));
+
+    if(header->Count > room || header->Count > (uint64_t)INT32_MAX)
+    {
+      _unmap();
+      throw runtime_error("avlt_image: " + path + " is cut short or has a corrupt count");
+    }
+
+    avlt_image_header expect = avlt_image_header::make(sizeof(KeyT), sizeof(ValueT), header->Count);
+
+    if(header->KeyBytes != expect.KeyBytes ||
+       header->ValueBytes != expect.ValueBytes || header->KeysOffset != expect.KeysOffset ||
+       header->ValuesOffset != expect.ValuesOffset ||
+       expect.ValuesOffset + header->Count * sizeof(ValueT) > Length)
+    {
+      _unmap();
+      throw runtime_error("avlt_image: " + path + " is not an image of these key/value types");
+    }
+
+    const char* base = static_cast<const char*>(Map);
+    Keys = reinterpret_cast<const KeyT*>(base + header->KeysOffset);
+    Values = reinterpret_cast<const ValueT*>(base + header->ValuesOffset);
+    Size = (size_t)header->Count;
+  }
+
+  avlt_image(const avlt_image&) = delete;
+  avlt_image& operator=(const avlt_image&) = delete;
+
+  //
+  // move constructor / move assignment:
+  //
+  // Takes over other's mapping, leaving other empty.
+  //
+  avlt_image(avlt_image&& other) noexcept
+    : Compare(other), Map(other.Map), Length(other.Length), Keys(other.Keys), Values(other.Values),
+      Size(other.Size)
+  {
+    other.Map = nullptr;
+    other._unmap();
+  }
+
+  avlt_image& operator=(avlt_image&& other) noexcept
+  {
+    if(this != &other)
+    {
+      _unmap();
+      static_cast<Compare&>(*this) = other;
+      swap(Map, other.Map);
+      swap(Length, other.Length);
+      swap(Keys, other.Keys);
+      swap(Values, other.Values);
+      swap(Size, other.Size);
+    }
+
+    return *this;
+  }
+
+  //
+  // destructor:
+  //
+  // Unmaps the file.
+  //
+  ~avlt_image()
+  {
+    _unmap();
+  }
+
+  //
+  // size:
+  //
+  // Returns the # of pairs.
+  //
+  // Time complexity:  O(1)
+  //
+  int size() const
+  {
+    return (int)Size;
+  }
+
+  //
+  // search:
+  //
+  // Same as avlt::search: true and the value if key is present, false
+  // if not.
+  //
+  // Time complexity:  O(lgN)
+  //
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    size_t i = _bound(key, false);
+
+    if(i == Size || _less(key, Keys[i]))  // Not found
+      return false;
+
+    value = Values[i];
+    return true;
+  }
+
+  //
+  // []
+  //
+  // Returns the value for the given key, or ValueT{} if not found.
+  //
+  // Time complexity:  O(lgN)
+  //
+  ValueT operator[](const KeyT& key) const
+  {
+    ValueT value{ };
+
+    search(key, value);
+    return value;
+  }
+
+  //
+  // const_iterator
+  //
+  // Forward iterator over the (key, value) pairs in key order; the
+  // same interface as avlt::const_iterator.
+  //
+  class const_iterator
+  {
+  private:
+    friend class avlt_image;
+
+    const avlt_image* Owner;  // image being walked
+    size_t            Index;  // index of the current pair, Size at the end
+
+    const_iterator(const avlt_image* owner, size_t index) : Owner(owner), Index(index) { }
+
+  public:
+    using iterator_category = forward_iterator_tag;
+    using value_type        = pair<KeyT, ValueT>;
+    using difference_type   = ptrdiff_t;
+    using reference         = pair<const KeyT&, const ValueT&>;
+    using pointer           = void;
+
+    const_iterator() : Owner(nullptr), Index(0) { }
+
+    const KeyT& key() const
+    {
+      return Owner->Keys[Index];
+    }
+
+    const ValueT& value() const
+    {
+      return Owner->Values[Index];
+    }
+
+    reference operator*() const
+    {
+      return reference(key(), value());
+    }
+
+    const_iterator& operator++()
+    {
+      Index++;
+      return *this;
+    }
+
+    const_iterator operator++(int)
+    {
+      const_iterator old = *this;
+      Index++;
+      return old;
+    }
+
+    bool operator==(const const_iterator& other) const
+    {
+      return Index == other.Index;
+    }
+
+    bool operator!=(const const_iterator& other) const
+    {
+      return Index != other.Index;
+    }
+  };
+
+  //
+  // cbegin / cend / begin / end:
+  //
+  // Iterators to the smallest pair and one past the largest.
+  //
+  // Time complexity:  O(1)
+  //
+  const_iterator cbegin() const
+  {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator cend() const
+  {
+    return const_iterator(this, Size);
+  }
+
+  const_iterator begin() const
+  {
+    return cbegin();
+  }
+
+  const_iterator end() const
+  {
+    return cend();
+  }
+
+  //
+  // find / lower_bound / upper_bound
+  //
+  // Same as avlt: iterator to the key, to the first key not less than
+  // it, or to the first key greater than it; cend() if there is none.
+  //
+  // Time complexity:  O(lgN)
+  //
+  const_iterator find(const KeyT& key) const
+  {
+    size_t i = _bound(key, false);
+
+    if(i != Size && _less(key, Keys[i]))  // Not found
+      i = Size;
+
+    return const_iterator(this, i);
+  }
+
+  const_iterator lower_bound(const KeyT& key) const
+  {
+    return const_iterator(this, _bound(key, false));
+  }
+
+  const_iterator upper_bound(const KeyT& key) const
+  {
+    return const_iterator(this, _bound(key, true));
+  }
+
+  //
+  // range_for_each
+  //
+  // Same as avlt::range_for_each: calls visit(key, value) for every pair
+  // in [lower..upper], in order; a visitor returning false stops the
+  // scan.  Returns the # of pairs visited.
+  //
+  // Time complexity:  O(lgN + M), where M is the # of pairs visited
+  //
+  template<typename Visitor>
+  size_t range_for_each(const KeyT& lower, const KeyT& upper, Visitor visit) const
+  {
+    size_t count = 0;
+
+    if(_less(upper, lower))  // Invalid bounds
+      return 0;
+
+    for(size_t i = _bound(lower, false); i < Size && !_less(upper, Keys[i]); i++)
+    {
+      count++;
+
+      if constexpr (is_void<decltype(visit(Keys[i], Values[i]))>::value)
+        visit(Keys[i], Values[i]);
+      else if(!visit(Keys[i], Values[i]))
+        break;
+    }
+
+    return count;
+  }
+
+  //
+  // range_search
+  //
+  // Same as avlt::range_search: every key in [lower..upper], inclusive,
+  // in order.
+  //
+  // Time complexity:  O(lgN + M)
+  //
+  vector<KeyT> range_search(const KeyT& lower, const KeyT& upper) const
+  {
+    vector<KeyT> keys;
+
+    range_for_each(lower, upper, [&](const KeyT& key, const ValueT&)
+    {
+      keys.push_back(key);
+    });
+
+    return keys;
+  }
+};
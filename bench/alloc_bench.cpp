@@ -0,0 +1,63 @@
+/*alloc_bench.cpp*/
+
+//
+// Compares the per-node heap path (avlt_new_alloc) against the slab
+// allocator (avlt_pool) for insert, search and clear.
+//
+// Build: g++ -std=c++17 -O2 -I.. alloc_bench.cpp -o alloc_bench
+// Usage: ./alloc_bench [N]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include "avlt.h"
+
+using namespace std;
+
+template<template<typename> class NodeAlloc>
+void run(const char* name, const vector<int>& keys)
+{
+  using clock = chrono::steady_clock;
+
+  avlt<int, int, NodeAlloc> tree;
+
+  auto t0 = clock::now();
+  for(int k : keys)
+    tree.insert(k, k);
+
+  auto t1 = clock::now();
+  long long found = 0;
+  int value;
+  for(int k : keys)
+    found += tree.search(k, value);
+
+  auto t2 = clock::now();
+  tree.clear();
+  auto t3 = clock::now();
+
+  auto ms = [](clock::time_point a, clock::time_point b)
+  {
+    return chrono::duration<double, milli>(b - a).count();
+  };
+
+  cout << name << ": insert " << ms(t0, t1) << " ms, search "
+       << ms(t1, t2) << " ms, clear " << ms(t2, t3) << " ms"
+       << " (" << found << " found)" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 1000000;
+
+  vector<int> keys(N);
+  mt19937 rng(251);
+  for(int& k : keys)
+    k = (int)(rng() & 0x7fffffff);
+
+  run<avlt_new_alloc>("new/delete", keys);
+  run<avlt_pool>("pool      ", keys);
+
+  return 0;
+}
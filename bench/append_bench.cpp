@@ -0,0 +1,70 @@
+/*append_bench.cpp*/
+
+//
+// Sequential-key ingest: N increasing keys (a time series with a
+// small fraction of late, slightly out-of-order keys) are loaded with
+// insert() and with push_back().  Also times N begin() calls, now
+// O(1) through the cached leftmost node.
+//
+// Build: g++ -std=c++17 -O2 -I.. append_bench.cpp -o append_bench
+// Usage: ./append_bench [N] [% of late keys]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include "avlt.h"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 1000000;
+  int late = (argc > 2) ? atoi(argv[2]) : 0;
+
+  /* Timestamps 1..3 apart; a late key lands a little behind the tail */
+  mt19937 rng(251);
+  vector<int> keys(N);
+  int stamp = 0;
+  for(int& key : keys)
+  {
+    stamp += 1 + rng() % 3;
+    key = ((int)(rng() % 100) < late) ? stamp - 1 - (int)(rng() % 64) : stamp;
+  }
+
+  avlt<int, int> inserted;
+  avlt<int, int> appended;
+
+  auto t0 = chrono::steady_clock::now();
+  for(int i = 0; i < N; i++)
+    inserted.insert(keys[i], i);
+
+  auto t1 = chrono::steady_clock::now();
+  for(int i = 0; i < N; i++)
+    appended.push_back(keys[i], i);
+
+  auto t2 = chrono::steady_clock::now();
+  long long sum = 0;
+  for(int i = 0; i < N; i++)
+  {
+    appended.begin();
+
+    int key = 0;
+    appended.next(key);
+    sum += key;
+  }
+
+  auto t3 = chrono::steady_clock::now();
+
+  double insertMs = chrono::duration<double, milli>(t1 - t0).count();
+  double appendMs = chrono::duration<double, milli>(t2 - t1).count();
+  double beginMs = chrono::duration<double, milli>(t3 - t2).count();
+
+  cout << "insert " << insertMs << " ms, push_back " << appendMs << " ms, speedup "
+       << insertMs / appendMs << " (" << inserted.size() << " / " << appended.size()
+       << " keys, " << late << "% late)" << endl;
+  cout << N << " x begin()+next(): " << beginMs << " ms (" << sum << ")" << endl;
+
+  return 0;
+}
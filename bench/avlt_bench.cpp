@@ -0,0 +1,761 @@
+/*avlt_bench.cpp*/
+
+//
+// Benchmark suite for avlt against std::map and a sorted std::vector.
+// For every combination of key type, key order and tree size it times
+// insert, search, range_search, operator(), operator% and a begin() /
+// next() scan, and prints one JSON document with ops/s, p50 and p99
+// latency and peak RSS per structure and operation, so two versions
+// can be compared by a script.
+//
+// Key orders (the keys are 0, 2, 4, ..., so odd keys miss):
+//
+//    sequential   inserted in increasing order
+//    random       inserted in random order
+//    zipf         inserted in random order, looked up Zipf-skewed
+//                 (theta 0.99), so a few keys take most lookups
+//    zigzag       inserted smallest, largest, next smallest, next
+//                 largest, ..., which keeps rebalancing both sides
+//
+// Latency is measured per operation, timer overhead included; for the
+// scan it is per key over chunks of 1024 keys.  Peak RSS is the high
+// water mark while each structure is built and used, from
+// /proc/self/status after a reset through /proc/self/clear_refs (Linux),
+// otherwise the process-wide getrusage() maximum.  The sorted vector is
+// built in bulk (append, sort), so its insert has no latency figures.
+//
+// Build: cmake -S .. -B build && cmake --build build --target avlt_bench
+// Usage: ./avlt_bench [--sizes 1000,100000,1000000] [--orders sequential,random,zipf,zigzag]
+//                     [--keys int,string] [--ops 1000000] [--out results.json]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "avlt.h"
+
+using namespace std;
+
+typedef chrono::steady_clock CLOCK;
+
+// One line of the report
+struct RESULT
+{
+  string    Structure;
+  string    KeyType;
+  string    Order;
+  long long Size;
+  string    Op;
+  long long Ops;
+  double    OpsPerSec;
+  double    P50;  // ns, < 0 => not measured
+  double    P99;
+  long      PeakRssKb;
+};
+
+//
+// Peak RSS
+//
+void resetPeakRss()
+{
+  FILE* f = fopen("/proc/self/clear_refs", "w");
+
+  if(f != nullptr)
+  {
+    fputs("5", f);  // Resets VmHWM to the current RSS
+    fclose(f);
+  }
+}
+
+long peakRssKb()
+{
+  FILE* f = fopen("/proc/self/status", "r");
+
+  if(f != nullptr)
+  {
+    char line[256];
+    long kb = -1;
+
+    while(fgets(line, sizeof(line), f) != nullptr)
+    {
+      if(strncmp(line, "VmHWM:", 6) == 0)
+        kb = atol(line + 6);
+    }
+
+    fclose(f);
+
+    if(kb >= 0)
+      return kb;
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+//
+// Keys
+//
+template<typename K>
+K makeKey(long long i);
+
+template<>
+int makeKey<int>(long long i)
+{
+  return (int)i;
+}
+
+// Zero-padded to a fixed width, so string order matches number order
+template<>
+string makeKey<string>(long long i)
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "key-%020lld", i);
+  return buf;
+}
+
+//
+// Zipf-distributed ranks in [0, n), theta < 1 (Gray et al., "Quickly
+// generating billion-record synthetic databases"); O(n) setup, O(1)
+// memory and time per draw
+//
+class ZIPF
+{
+private:
+  long long N;
+  double    Theta, Alpha, Zeta, Eta;
+
+public:
+  ZIPF(long long n, double theta) : N(n), Theta(theta)
+  {
+    double zeta2 = 1.0 + pow(0.5, theta);
+
+    Zeta = 0;
+    for(long long i = 1; i <= n; i++)
+      Zeta += 1.0 / pow((double)i, theta);
+
+    Alpha = 1.0 / (1.0 - theta);
+    Eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / Zeta);
+  }
+
+  long long operator()(mt19937_64& rng)
+  {
+    double u = (rng() >> 11) * (1.0 / 9007199254740992.0);
+    double uz = u * Zeta;
+
+    if(uz < 1.0)
+      return 0;
+
+    if(uz < 1.0 + pow(0.5, Theta))
+      return 1;
+
+    long long r = (long long)(N * pow(Eta * u - Eta + 1.0, Alpha));
+    return (r < N) ? r : N - 1;
+  }
+};
+
+//
+// Workload: insertion order and probe sequences for one configuration
+//
+struct WORKLOAD
+{
+  vector<long long> Inserts;  // key numbers, in insertion order
+  vector<long long> Probes;   // key numbers to look up, half of them misses
+  vector<long long> Ranges;   // first key number of each range query
+};
+
+WORKLOAD makeWorkload(const string& order, long long n, long long ops, mt19937_64& rng)
+{
+  WORKLOAD w;
+  w.Inserts.resize(n);
+
+  for(long long i = 0; i < n; i++)
+    w.Inserts[i] = 2 * i;
+
+  if(order == "random" || order == "zipf")
+    shuffle(w.Inserts.begin(), w.Inserts.end(), rng);
+  else if(order == "zigzag")
+  {
+    for(long long i = 0, lo = 0, hi = n - 1; lo <= hi; i++)
+      w.Inserts[i] = 2 * ((i % 2 == 0) ? lo++ : hi--);
+  }
+
+  /* Hot keys are scattered over the key space, not clustered at
+   * the low end: rank r maps to key number (r * prime) mod n */
+  const long long prime = 2654435761LL;
+  ZIPF* zipf = (order == "zipf") ? new ZIPF(n, 0.99) : nullptr;
+
+  auto pick = [&]() -> long long
+  {
+    if(zipf != nullptr)
+      return (long long)((unsigned long long)(*zipf)(rng) * prime % n);
+
+    return (long long)(rng() % n);
+  };
+
+  w.Probes.resize(ops);
+  for(long long i = 0; i < ops; i++)
+    w.Probes[i] = 2 * pick() + (i % 2);  // Odd => miss
+
+  w.Ranges.resize(ops / 100 + 1);
+  for(long long& r : w.Ranges)
+    r = 2 * pick();
+
+  delete zipf;
+  return w;
+}
+
+//
+// Timing
+//
+class TIMER
+{
+private:
+  vector<float> Latency;  // ns per op
+  CLOCK::time_point Start;
+
+public:
+  CLOCK::time_point Total;  // start of the whole run
+
+  void reserve(size_t n)
+  {
+    Latency.clear();
+    Latency.reserve(n);
+    Total = CLOCK::now();
+  }
+
+  void start()
+  {
+    Start = CLOCK::now();
+  }
+
+  void stop(long long ops = 1)
+  {
+    Latency.push_back((float)chrono::duration<double, nano>(CLOCK::now() - Start).count() / ops);
+  }
+
+  // Fills in ops/s and the percentiles of a finished run
+  void finish(RESULT& r)
+  {
+    double seconds = chrono::duration<double>(CLOCK::now() - Total).count();
+    r.OpsPerSec = (seconds > 0) ? r.Ops / seconds : 0;
+    r.P50 = percentile(0.50);
+    r.P99 = percentile(0.99);
+  }
+
+  double percentile(double p)
+  {
+    if(Latency.empty())
+      return -1;
+
+    size_t k = (size_t)(p * (Latency.size() - 1));
+    nth_element(Latency.begin(), Latency.begin() + k, Latency.end());
+    return Latency[k];
+  }
+};
+
+// Folds a key into a checksum, so lookups are not optimized away
+long long weigh(int k)
+{
+  return k;
+}
+
+long long weigh(const string& k)
+{
+  return (long long)k.size();
+}
+
+//
+// Adapters: one interface over the three structures
+//
+template<typename K>
+struct AVLT
+{
+  static const char* name() { return "avlt"; }
+
+  avlt<K, int> Tree;
+
+  void insert(const K& k, int v) { Tree.insert(k, v); }
+  bool search(const K& k, int& v) const { return Tree.search(k, v); }
+  size_t range(const K& lo, const K& hi) const { return Tree.range_search(lo, hi).size(); }
+  K successor(const K& k) const { return Tree(k); }
+  int height(const K& k) const { return Tree % k; }
+  static const bool hasHeight = true;
+
+  // Scans every key in order, timing chunks of 1024
+  long long scan(TIMER& timer, long long& sink)
+  {
+    long long n = 0;
+    K key;
+
+    Tree.begin();
+    while(true)
+    {
+      timer.start();
+
+      int i = 0;
+      while(i < 1024 && Tree.next(key))
+      {
+        sink += weigh(key);
+        i++;
+      }
+
+      if(i == 0)
+        break;
+
+      timer.stop(i);
+      n += i;
+    }
+
+    return n;
+  }
+};
+
+template<typename K>
+struct MAP
+{
+  static const char* name() { return "std::map"; }
+
+  map<K, int> Tree;
+
+  void insert(const K& k, int v) { Tree.insert(make_pair(k, v)); }
+
+  bool search(const K& k, int& v) const
+  {
+    auto it = Tree.find(k);
+    if(it == Tree.end())
+      return false;
+
+    v = it->second;
+    return true;
+  }
+
+  size_t range(const K& lo, const K& hi) const
+  {
+    vector<K> keys;
+    for(auto it = Tree.lower_bound(lo); it != Tree.end() && !(hi < it->first); ++it)
+      keys.push_back(it->first);
+
+    return keys.size();
+  }
+
+  K successor(const K& k) const
+  {
+    auto it = Tree.upper_bound(k);
+    return (it == Tree.end()) ? K{ } : it->first;
+  }
+
+  int height(const K&) const { return 0; }
+  static const bool hasHeight = false;
+
+  long long scan(TIMER& timer, long long& sink)
+  {
+    long long n = 0;
+    auto it = Tree.begin();
+
+    while(it != Tree.end())
+    {
+      timer.start();
+
+      int i = 0;
+      for(; i < 1024 && it != Tree.end(); ++it, i++)
+        sink += weigh(it->first);
+
+      timer.stop(i);
+      n += i;
+    }
+
+    return n;
+  }
+};
+
+template<typename K>
+struct VECTOR
+{
+  static const char* name() { return "sorted_vector"; }
+
+  vector<pair<K, int>> Pairs;
+
+  void insert(const K& k, int v) { Pairs.push_back(make_pair(k, v)); }
+
+  // Sorts once after all the inserts
+  void seal()
+  {
+    sort(Pairs.begin(), Pairs.end(), [](const pair<K, int>& a, const pair<K, int>& b)
+    {
+      return a.first < b.first;
+    });
+  }
+
+  typename vector<pair<K, int>>::const_iterator lower(const K& k) const
+  {
+    return lower_bound(Pairs.begin(), Pairs.end(), k, [](const pair<K, int>& p, const K& key)
+    {
+      return p.first < key;
+    });
+  }
+
+  bool search(const K& k, int& v) const
+  {
+    auto it = lower(k);
+    if(it == Pairs.end() || k < it->first)
+      return false;
+
+    v = it->second;
+    return true;
+  }
+
+  size_t range(const K& lo, const K& hi) const
+  {
+    vector<K> keys;
+    for(auto it = lower(lo); it != Pairs.end() && !(hi < it->first); ++it)
+      keys.push_back(it->first);
+
+    return keys.size();
+  }
+
+  K successor(const K& k) const
+  {
+    auto it = lower(k);
+    if(it != Pairs.end() && !(k < it->first))
+      ++it;
+
+    return (it == Pairs.end()) ? K{ } : it->first;
+  }
+
+  int height(const K&) const { return 0; }
+  static const bool hasHeight = false;
+
+  long long scan(TIMER& timer, long long& sink)
+  {
+    long long n = 0;
+
+    for(size_t first = 0; first < Pairs.size(); first += 1024)
+    {
+      timer.start();
+
+      size_t last = min(first + 1024, Pairs.size());
+      for(size_t i = first; i < last; i++)
+        sink += weigh(Pairs[i].first);
+
+      timer.stop((long long)(last - first));
+      n += (long long)(last - first);
+    }
+
+    return n;
+  }
+};
+
+template<typename T>
+struct IS_VECTOR : false_type { };
+
+template<typename K>
+struct IS_VECTOR<VECTOR<K>> : true_type { };
+
+// Where the checksums go
+volatile long long Sink;
+
+//
+// Runs every operation against one structure
+//
+template<typename S, typename K>
+void run(vector<RESULT>& results, const string& keyType, const string& order,
+         const WORKLOAD& w, const vector<K>& keys, const vector<K>& probes, const vector<K>& ranges)
+{
+  long long n = (long long)w.Inserts.size();
+  RESULT base = {S::name(), keyType, order, n, "", 0, 0, -1, -1, 0};
+  TIMER timer;
+
+  resetPeakRss();
+  S* s = new S();
+
+  /* insert */
+  RESULT r = base;
+  r.Op = "insert";
+  r.Ops = n;
+  timer.reserve(IS_VECTOR<S>::value ? 0 : n);
+
+  for(long long i = 0; i < n; i++)
+  {
+    if constexpr (!IS_VECTOR<S>::value)
+      timer.start();
+
+    s->insert(keys[i], (int)i);
+
+    if constexpr (!IS_VECTOR<S>::value)
+      timer.stop();
+  }
+
+  if constexpr (IS_VECTOR<S>::value)
+    s->seal();
+
+  timer.finish(r);
+  r.PeakRssKb = peakRssKb();
+  results.push_back(r);
+
+  /* search, half hits, half misses */
+  r = base;
+  r.Op = "search";
+  r.Ops = (long long)probes.size();
+  timer.reserve(probes.size());
+  long long hits = 0;
+
+  for(const K& k : probes)
+  {
+    int v;
+    timer.start();
+    hits += s->search(k, v);
+    timer.stop();
+  }
+
+  Sink = hits;
+  timer.finish(r);
+  r.PeakRssKb = peakRssKb();
+  results.push_back(r);
+
+  /* range_search, ~100 keys per range */
+  r = base;
+  r.Op = "range_search";
+  r.Ops = (long long)ranges.size();
+  timer.reserve(ranges.size());
+  long long found = 0;
+
+  for(size_t i = 0; i < ranges.size(); i += 2)
+  {
+    timer.start();
+    found += (long long)s->range(ranges[i], ranges[i + 1]);
+    timer.stop();
+  }
+
+  r.Ops = (long long)ranges.size() / 2;
+  Sink = found;
+  timer.finish(r);
+  r.PeakRssKb = peakRssKb();
+  results.push_back(r);
+
+  /* operator(): key to the right; upper_bound for the others */
+  r = base;
+  r.Op = "successor";
+  r.Ops = (long long)probes.size();
+  timer.reserve(probes.size());
+  long long total = 0;
+
+  for(const K& k : probes)
+  {
+    timer.start();
+    total += weigh(s->successor(k));
+    timer.stop();
+  }
+
+  Sink = total;
+  timer.finish(r);
+  r.PeakRssKb = peakRssKb();
+  results.push_back(r);
+
+  /* operator%: height of the node holding a key, avlt only */
+  if constexpr (S::hasHeight)
+  {
+    r = base;
+    r.Op = "height";
+    r.Ops = (long long)probes.size();
+    timer.reserve(probes.size());
+    total = 0;
+
+    for(const K& k : probes)
+    {
+      timer.start();
+      total += s->height(k);
+      timer.stop();
+    }
+
+    Sink = total;
+    timer.finish(r);
+    r.PeakRssKb = peakRssKb();
+    results.push_back(r);
+  }
+
+  /* begin()/next() scan of every key */
+  r = base;
+  r.Op = "scan";
+  timer.reserve((size_t)(n / 1024 + 1));
+  total = 0;
+
+  r.Ops = s->scan(timer, total);
+  Sink = total;
+  timer.finish(r);
+  r.PeakRssKb = peakRssKb();
+  results.push_back(r);
+
+  delete s;
+}
+
+template<typename K>
+void runKeys(vector<RESULT>& results, const string& keyType, const string& order,
+             long long n, long long ops, mt19937_64& rng)
+{
+  WORKLOAD w = makeWorkload(order, n, ops, rng);
+  vector<K> keys, probes, ranges;
+
+  keys.reserve(n);
+  for(long long i : w.Inserts)
+    keys.push_back(makeKey<K>(i));
+
+  probes.reserve(w.Probes.size());
+  for(long long i : w.Probes)
+    probes.push_back(makeKey<K>(i));
+
+  for(long long i : w.Ranges)  // [lower, upper] pairs, 100 keys apart
+  {
+    ranges.push_back(makeKey<K>(i));
+    ranges.push_back(makeKey<K>(i + 2 * 99));
+  }
+
+  /* The key vectors are counted in every structure's peak RSS
+   * alike; compare the structures against each other */
+  run<AVLT<K>>(results, keyType, order, w, keys, probes, ranges);
+  run<MAP<K>>(results, keyType, order, w, keys, probes, ranges);
+  run<VECTOR<K>>(results, keyType, order, w, keys, probes, ranges);
+}
+
+//
+// Command line and JSON
+//
+vector<string> splitList(const string& s)
+{
+  vector<string> items;
+  stringstream ss(s);
+  string item;
+
+  while(getline(ss, item, ','))
+  {
+    if(!item.empty())
+      items.push_back(item);
+  }
+
+  return items;
+}
+
+string jsonNumber(double x)
+{
+  if(x < 0)
+    return "null";
+
+  ostringstream out;
+  out.precision(6);
+  out << fixed << x;
+  return out.str();
+}
+
+void writeJson(ostream& out, const vector<RESULT>& results)
+{
+  out << "{\n  \"benchmark\": \"avlt_bench\",\n  \"version\": 1,\n  \"results\": [\n";
+
+  for(size_t i = 0; i < results.size(); i++)
+  {
+    const RESULT& r = results[i];
+
+    out << "    {\"structure\": \"" << r.Structure << "\", \"key\": \"" << r.KeyType
+        << "\", \"order\": \"" << r.Order << "\", \"size\": " << r.Size << ", \"op\": \""
+        << r.Op << "\", \"ops\": " << r.Ops << ", \"ops_per_sec\": " << jsonNumber(r.OpsPerSec)
+        << ", \"p50_ns\": " << jsonNumber(r.P50) << ", \"p99_ns\": " << jsonNumber(r.P99)
+        << ", \"peak_rss_kb\": " << r.PeakRssKb << "}" << ((i + 1 < results.size()) ? "," : "")
+        << "\n";
+  }
+
+  out << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+  vector<string> sizes = {"1000", "100000", "1000000"};
+  vector<string> orders = {"sequential", "random", "zipf", "zigzag"};
+  vector<string> keyTypes = {"int", "string"};
+  long long ops = 1000000;
+  string outPath;
+
+  for(int i = 1; i < argc; i++)
+  {
+    string arg = argv[i];
+    string value = (i + 1 < argc) ? argv[i + 1] : "";
+
+    if(arg == "--sizes")
+      sizes = splitList(value);
+    else if(arg == "--orders")
+      orders = splitList(value);
+    else if(arg == "--keys")
+      keyTypes = splitList(value);
+    else if(arg == "--ops")
+      ops = atoll(value.c_str());
+    else if(arg == "--out")
+      outPath = value;
+    else
+    {
+      cerr << "usage: " << argv[0] << " [--sizes 1000,100000,...] [--orders "
+           << "sequential,random,zipf,zigzag] [--keys int,string] [--ops N] [--out file]" << endl;
+      return 1;
+    }
+
+    i++;
+  }
+
+  mt19937_64 rng(251);
+  vector<RESULT> results;
+
+  for(const string& keyType : keyTypes)
+  {
+    for(const string& order : orders)
+    {
+      for(const string& size : sizes)
+      {
+        long long n = atoll(size.c_str());
+
+        if(n < 1 || n > 1000000000LL || (order != "sequential" && order != "random" &&
+                                         order != "zipf" && order != "zigzag"))
+        {
+          cerr << "avlt_bench: bad size or order: " << size << ", " << order << endl;
+          return 1;
+        }
+
+        cerr << keyType << " / " << order << " / " << n << endl;
+
+        if(keyType == "int")
+          runKeys<int>(results, keyType, order, n, ops, rng);
+        else if(keyType == "string")
+          runKeys<string>(results, keyType, order, n, ops, rng);
+        else
+        {
+          cerr << "avlt_bench: bad key type: " << keyType << endl;
+          return 1;
+        }
+      }
+    }
+  }
+
+  if(outPath.empty())
+    writeJson(cout, results);
+  else
+  {
+    ofstream out(outPath);
+    writeJson(out, results);
+
+    if(!out)
+    {
+      cerr << "avlt_bench: cannot write " << outPath << endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
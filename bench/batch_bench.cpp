@@ -0,0 +1,80 @@
+/*batch_bench.cpp*/
+
+//
+// Sorted micro-batches: a tree of N random keys receives batches of B
+// sorted keys drawn from a narrow key window (dense) or from the whole
+// key space (sparse).  Compares a loop of insert() against
+// insert_batch().
+//
+// Build: g++ -std=c++17 -O2 -I.. batch_bench.cpp -o batch_bench
+// Usage: ./batch_bench [N] [batch size] [batches]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include "avlt.h"
+
+using namespace std;
+
+/* Makes sorted batches; dense ones fall in a window
+ * about as wide as the batch is long */
+vector<vector<pair<int, int>>> batches(int count, int B, bool dense, mt19937& rng)
+{
+  vector<vector<pair<int, int>>> all(count);
+
+  for(auto& batch : all)
+  {
+    unsigned start = rng() & 0x3fffffff;
+    for(int i = 0; i < B; i++)
+    {
+      int key = dense ? (int)(start + rng() % (4u * B)) : (int)(rng() & 0x3fffffff);
+      batch.push_back(make_pair(key, i));
+    }
+
+    sort(batch.begin(), batch.end());
+  }
+
+  return all;
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 100000;
+  int B = (argc > 2) ? atoi(argv[2]) : 10000;
+  int count = (argc > 3) ? atoi(argv[3]) : 50;
+
+  mt19937 rng(251);
+  vector<pair<int, int>> base(N);
+  for(auto& kv : base)
+    kv = make_pair((int)(rng() & 0x3fffffff), 0);
+
+  for(bool dense : {true, false})
+  {
+    auto work = batches(count, B, dense, rng);
+
+    avlt<int, int> looped(base.begin(), base.end());
+    avlt<int, int> batched(base.begin(), base.end());
+
+    auto t0 = chrono::steady_clock::now();
+    for(auto& batch : work)
+      for(auto& kv : batch)
+        looped.insert(kv.first, kv.second);
+
+    auto t1 = chrono::steady_clock::now();
+    for(auto& batch : work)
+      batched.insert_batch(batch.begin(), batch.end());
+
+    auto t2 = chrono::steady_clock::now();
+
+    double loopMs = chrono::duration<double, milli>(t1 - t0).count();
+    double batchMs = chrono::duration<double, milli>(t2 - t1).count();
+
+    cout << (dense ? "dense : " : "sparse: ") << "insert loop " << loopMs
+         << " ms, insert_batch " << batchMs << " ms, speedup " << loopMs / batchMs
+         << " (" << looped.size() << " / " << batched.size() << " keys)" << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,107 @@
+/*compact_bench.cpp*/
+
+//
+// Memory per node and search latency of avlt (with avlt_pool and with
+// avlt_new_alloc) against compact_avlt, for int keys and int values.
+// Global operator new is replaced with a version that tracks the bytes
+// currently allocated, so the memory report covers everything each
+// tree holds (pool blocks, node array slack included).
+//
+// Build: g++ -std=c++17 -O2 -I.. compact_bench.cpp -o compact_bench
+// Usage: ./compact_bench [N] [lookups]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include "avlt.h"
+#include "compact_avlt.h"
+
+using namespace std;
+
+static long long LiveBytes = 0;  // bytes currently allocated
+
+// Every block carries its size in a header so delete can subtract it
+static const size_t HeaderBytes = alignof(max_align_t);
+
+void* operator new(size_t bytes)
+{
+  unsigned char* p = static_cast<unsigned char*>(malloc(bytes + HeaderBytes));
+  if(p == nullptr)
+    throw bad_alloc();
+
+  *reinterpret_cast<size_t*>(p) = bytes;
+  LiveBytes += bytes;
+
+  return p + HeaderBytes;
+}
+
+void operator delete(void* p) noexcept
+{
+  if(p == nullptr)
+    return;
+
+  unsigned char* block = static_cast<unsigned char*>(p) - HeaderBytes;
+  LiveBytes -= *reinterpret_cast<size_t*>(block);
+  free(block);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+template<typename Tree>
+void run(const char* name, const vector<int>& keys, const vector<int>& probes)
+{
+  long long before = LiveBytes;
+  Tree tree;
+
+  auto t0 = chrono::steady_clock::now();
+  for(int k : keys)
+    tree.insert(k, k);
+
+  auto t1 = chrono::steady_clock::now();
+  long long bytes = LiveBytes - before;
+
+  long long sum = 0;
+  for(int k : probes)
+  {
+    int value;
+    if(tree.search(k, value))
+      sum += value;
+  }
+
+  auto t2 = chrono::steady_clock::now();
+
+  double insertMs = chrono::duration<double, milli>(t1 - t0).count();
+  double searchNs = chrono::duration<double, nano>(t2 - t1).count() / probes.size();
+
+  cout << name << ": " << (double)bytes / tree.size() << " bytes/node, insert "
+       << insertMs << " ms, search " << searchNs << " ns/lookup (" << sum << ")" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 2000000;
+  int lookups = (argc > 2) ? atoi(argv[2]) : 2000000;
+
+  mt19937 rng(251);
+  vector<int> keys(N);
+  for(int& k : keys)
+    k = (int)(rng() & 0x3fffffff);
+
+  /* Half the probes hit, half are random and mostly miss */
+  vector<int> probes(lookups);
+  for(int i = 0; i < lookups; i++)
+    probes[i] = (i % 2 == 0) ? keys[rng() % N] : (int)(rng() & 0x3fffffff);
+
+  cout << "compact node: " << compact_avlt<int, int>::node_bytes() << " bytes" << endl;
+
+  run<avlt<int, int, avlt_new_alloc>>("avlt, new/delete", keys, probes);
+  run<avlt<int, int>>("avlt, pool      ", keys, probes);
+  run<compact_avlt<int, int>>("compact_avlt    ", keys, probes);
+
+  return 0;
+}
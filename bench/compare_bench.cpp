@@ -0,0 +1,98 @@
+/*compare_bench.cpp*/
+
+//
+// Long string keys that share a long prefix, so every comparison has
+// to walk most of the string: inserts and lookups with the default
+// three-way avlt_compare against a two-way std::less<string>, which
+// needs up to two comparisons per node like the old == / < descent.
+// Lookups are also made by string_view and by C string, which the
+// transparent default compares in place, while std::less<string> has
+// to build a temporary string for each one.
+//
+// Build: g++ -std=c++17 -O2 -I.. compare_bench.cpp -o compare_bench
+// Usage: ./compare_bench [N] [prefix length]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "avlt.h"
+
+using namespace std;
+
+// ns per call of f(i) over i = 0..n-1
+template<typename F>
+double timed(size_t n, F f)
+{
+  auto t0 = chrono::steady_clock::now();
+
+  for(size_t i = 0; i < n; i++)
+    f(i);
+
+  auto t1 = chrono::steady_clock::now();
+  return chrono::duration<double, nano>(t1 - t0).count() / n;
+}
+
+// The probe as a key the tree can search by: itself when Compare is
+// transparent, otherwise a string built from it
+template<typename Compare, typename K>
+auto probe(const K& key)
+{
+  if constexpr (avlt_transparent<Compare>::value)
+    return key;
+  else
+    return string(key);
+}
+
+template<typename Compare>
+void run(const char* name, const vector<string>& keys, const vector<string>& probes)
+{
+  avlt<string, int, avlt_pool, false, avlt_no_stats, Compare> tree;
+  long long found = 0;
+  int value;
+
+  double insert = timed(keys.size(), [&](size_t i) { tree.insert(keys[i], (int)i); });
+  double byString = timed(probes.size(), [&](size_t i) { found += tree.search(probes[i], value); });
+
+  double byView = timed(probes.size(), [&](size_t i)
+  {
+    found += tree.search(probe<Compare>(string_view(probes[i])), value);
+  });
+
+  double byChars = timed(probes.size(), [&](size_t i)
+  {
+    found += tree.search(probe<Compare>(probes[i].c_str()), value);
+  });
+
+  cout << "  " << name << ": insert " << insert << " ns, search by string " << byString
+       << " ns, string_view " << byView << " ns, const char* " << byChars << " ns ("
+       << found << " found)" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 1000000;
+  int prefix = (argc > 2) ? atoi(argv[2]) : 64;
+
+  mt19937 rng(251);
+  vector<string> keys(N), probes(N);
+  string common = "/var/data/tenants/" + string(max(prefix - 18, 0), 'x') + "/";
+
+  for(int i = 0; i < N; i++)
+    keys[i] = common + to_string(rng());
+
+  /* Half the probes hit, half miss */
+  for(int i = 0; i < N; i++)
+    probes[i] = (i % 2 == 0) ? keys[rng() % N] : common + to_string(rng());
+
+  cout << "N=" << N << ", keys of " << keys[0].size() << " chars" << endl;
+
+  run<avlt_compare>("avlt_compare", keys, probes);
+  run<less<string>>("less<string>", keys, probes);
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+/*concurrent_read_bench.cpp*/
+
+//
+// Read scaling with one writer: 1..T reader threads run random search()
+// calls while one writer keeps inserting.  Compares an avlt behind a
+// global mutex against concurrent_avlt, whose readers lock only the
+// shard they search, so they rarely wait for the writer.
+//
+// Build: g++ -std=c++17 -O2 -pthread -I.. concurrent_read_bench.cpp -o concurrent_read_bench
+// Usage: ./concurrent_read_bench [N] [max threads] [ms per run]
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "avlt.h"
+#include "concurrent_avlt.h"
+
+using namespace std;
+
+/* Runs "readers" reader threads and one writer thread for "ms"
+ * milliseconds, returning the # of reads per second */
+template<typename Read, typename Write>
+double run(int readers, int ms, Read read, Write write)
+{
+  atomic<bool> stop(false);
+  atomic<long long> reads(0);
+  vector<thread> threads;
+
+  for(int r = 0; r < readers; r++)
+  {
+    threads.push_back(thread([&, r]
+    {
+      mt19937 rng(r);
+      long long n = 0;
+      while(!stop.load(memory_order_relaxed))
+      {
+        read(rng);
+        n++;
+      }
+      reads += n;
+    }));
+  }
+
+  threads.push_back(thread([&]
+  {
+    mt19937 rng(1000);
+    while(!stop.load(memory_order_relaxed))
+      write(rng);
+  }));
+
+  this_thread::sleep_for(chrono::milliseconds(ms));
+  stop = true;
+
+  for(thread& t : threads)
+    t.join();
+
+  return reads * 1000.0 / ms;
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 1000000;
+  int maxThreads = (argc > 2) ? atoi(argv[2]) : (int)thread::hardware_concurrency();
+  int ms = (argc > 3) ? atoi(argv[3]) : 1000;
+
+  vector<pair<int, int>> pairs(N);
+  for(int i = 0; i < N; i++)
+    pairs[i] = make_pair(2 * i, i);
+
+  avlt<int, int> locked(pairs.begin(), pairs.end());
+  mutex lock;
+
+  concurrent_avlt<int, int> shared(pairs.begin(), pairs.end());
+
+  for(int readers = 1; readers <= maxThreads; readers *= 2)
+  {
+    double mutexRate = run(readers, ms,
+      [&](mt19937& rng)
+      {
+        int value;
+        lock_guard<mutex> guard(lock);
+        locked.search((int)(rng() % (2 * (unsigned)N)), value);
+      },
+      [&](mt19937& rng)
+      {
+        lock_guard<mutex> guard(lock);
+        locked.insert((int)(rng() % (2 * (unsigned)N)) | 1, 0);
+      });
+
+    double shardedRate = run(readers, ms,
+      [&](mt19937& rng)
+      {
+        int value;
+        shared.search((int)(rng() % (2 * (unsigned)N)), value);
+      },
+      [&](mt19937& rng)
+      {
+        shared.insert((int)(rng() % (2 * (unsigned)N)) | 1, 0);
+      });
+
+    cout << readers << " readers: mutex " << mutexRate << " reads/s, sharded "
+         << shardedRate << " reads/s" << endl;
+  }
+
+  return 0;
+}
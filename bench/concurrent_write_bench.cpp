@@ -0,0 +1,88 @@
+/*concurrent_write_bench.cpp*/
+
+//
+// Write scaling: 1/2/4/8/16 producer threads insert disjoint key streams
+// (thread t inserts t, t + T, t + 2T, ...).  Compares an avlt behind a
+// global mutex against concurrent_avlt, whose writers only lock the
+// shard that owns their key.  It gets a few shards per writer, with
+// boundaries taken from a sample of the keys that will be inserted.
+//
+// Build: g++ -std=c++17 -O2 -pthread -I.. concurrent_write_bench.cpp -o concurrent_write_bench
+// Usage: ./concurrent_write_bench [N] [shards per writer]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+#include "avlt.h"
+#include "concurrent_avlt.h"
+
+using namespace std;
+
+/* The k-th key of the streams, scattered so threads don't just append */
+static int streamKey(int k)
+{
+  return (int)(((unsigned)k * 2654435761u) & 0x7fffffff);
+}
+
+/* Runs "threads" producers calling insert(key) over N keys
+ * in total, returning the # of inserts per second */
+template<typename Insert>
+double run(int threads, int N, Insert insert)
+{
+  vector<thread> producers;
+  auto t0 = chrono::steady_clock::now();
+
+  for(int t = 0; t < threads; t++)
+  {
+    producers.push_back(thread([=]
+    {
+      for(int k = t; k < N; k += threads)
+        insert(streamKey(k));
+    }));
+  }
+
+  for(thread& p : producers)
+    p.join();
+
+  auto t1 = chrono::steady_clock::now();
+  return N / chrono::duration<double>(t1 - t0).count();
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 1000000;
+  int perWriter = (argc > 2) ? atoi(argv[2]) : 4;
+
+  /* Every 64th key, as a producer would know its key distribution */
+  vector<int> samples;
+  for(int k = 0; k < N; k += 64)
+    samples.push_back(streamKey(k));
+
+  for(int threads = 1; threads <= 16; threads *= 2)
+  {
+    avlt<int, int> locked;
+    mutex lock;
+
+    double mutexRate = run(threads, N, [&](int key)
+    {
+      lock_guard<mutex> guard(lock);
+      locked.insert(key, key);
+    });
+
+    concurrent_avlt<int, int> sharded(samples, perWriter * threads);
+
+    double shardedRate = run(threads, N, [&](int key)
+    {
+      sharded.insert(key, key);
+    });
+
+    cout << threads << " writers: mutex " << mutexRate << " inserts/s, "
+         << sharded.shard_count() << " locked shards " << shardedRate
+         << " inserts/s (" << sharded.size() << " keys)" << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,101 @@
+/*durable_bench.cpp*/
+
+//
+// Insert throughput of durable_avlt against a plain in-memory avlt:
+// one fsync per insert, group commit with T threads each waiting for
+// its own fsync, and batched fsyncs every B inserts.
+//
+// Build: g++ -std=c++17 -O2 -pthread -I.. durable_bench.cpp -o durable_bench
+// Usage: ./durable_bench [N] [threads] [batch] [directory]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+#include "durable_avlt.h"
+
+using namespace std;
+
+template<typename Fn>
+double opsPerSec(int ops, Fn fn)
+{
+  auto t0 = chrono::steady_clock::now();
+  fn();
+  auto t1 = chrono::steady_clock::now();
+
+  return ops / chrono::duration<double>(t1 - t0).count();
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 1000000;
+  int T = (argc > 2) ? atoi(argv[2]) : 8;
+  int B = (argc > 3) ? atoi(argv[3]) : 16384;
+  string dir = (argc > 4) ? argv[4] : "durable_bench.dir";
+
+  mt19937 rng(251);
+  vector<int> keys(N);
+  for(int i = 0; i < N; i++)
+    keys[i] = (int)(rng() & 0x3fffffff);
+
+  auto wipe = [&]()
+  {
+    remove((dir + "/journal").c_str());
+    remove((dir + "/checkpoint").c_str());
+    rmdir(dir.c_str());
+  };
+
+  double memory = opsPerSec(N, [&]()
+  {
+    avlt<int, int> tree;
+    for(int i = 0; i < N; i++)
+      tree.insert(keys[i], i);
+  });
+
+  int fewer = (N < 2000) ? N : 2000;  // Every insert waits for an fsync
+  wipe();
+  double single = opsPerSec(fewer, [&]()
+  {
+    durable_avlt<int, int> tree(dir, 1);
+    for(int i = 0; i < fewer; i++)
+      tree.insert(keys[i], i);
+  });
+
+  int grouped = fewer * T;
+  wipe();
+  double group = opsPerSec(grouped, [&]()
+  {
+    durable_avlt<int, int> tree(dir, 1);
+    vector<thread> threads;
+
+    for(int t = 0; t < T; t++)
+      threads.emplace_back([&, t]()
+      {
+        for(int i = t; i < grouped; i += T)
+          tree.insert(keys[i % N] + i / N, i);
+      });
+
+    for(thread& th : threads)
+      th.join();
+  });
+
+  wipe();
+  double batched = opsPerSec(N, [&]()
+  {
+    durable_avlt<int, int> tree(dir, B);
+    for(int i = 0; i < N; i++)
+      tree.insert(keys[i], i);
+  });
+
+  wipe();
+
+  cout << "N=" << N << " inserts, M ops/s:" << endl;
+  cout << "  in-memory avlt:                " << memory / 1e6 << endl;
+  cout << "  fsync per insert:              " << single / 1e6 << endl;
+  cout << "  group commit, " << T << " threads:      " << group / 1e6 << endl;
+  cout << "  batched, fsync every " << B << ":    " << batched / 1e6 << endl;
+
+  return 0;
+}
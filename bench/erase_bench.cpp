@@ -0,0 +1,58 @@
+/*erase_bench.cpp*/
+
+//
+// Mixed insert/erase churn on a tree of roughly constant size.  After
+// every round the tree height is checked against the AVL bound
+// 1.44 * lg(N + 2).
+//
+// Build: g++ -std=c++17 -O2 -I.. erase_bench.cpp -o erase_bench
+// Usage: ./erase_bench [N] [rounds]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include "avlt.h"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 1000000;
+  int rounds = (argc > 2) ? atoi(argv[2]) : 10;
+
+  mt19937 rng(251);
+  avlt<int, int> tree;
+
+  for(int i = 0; i < N; i++)
+    tree.insert((int)(rng() % (2 * (unsigned)N)), i);
+
+  bool withinBound = true;
+  auto t0 = chrono::steady_clock::now();
+
+  for(int r = 0; r < rounds; r++)
+  {
+    /* One erase and one insert per step keeps the size steady */
+    for(int i = 0; i < N; i++)
+    {
+      tree.erase((int)(rng() % (2 * (unsigned)N)));
+      tree.insert((int)(rng() % (2 * (unsigned)N)), i);
+    }
+
+    double bound = 1.44 * log2(tree.size() + 2.0);
+    cout << "round " << r << ": size " << tree.size() << ", height "
+         << tree.height() << ", AVL bound " << bound << endl;
+
+    if(tree.height() > bound)
+      withinBound = false;
+  }
+
+  auto t1 = chrono::steady_clock::now();
+  double secs = chrono::duration<double>(t1 - t0).count();
+
+  cout << "churn: " << (2.0 * N * rounds) / secs << " ops/s" << endl;
+  cout << (withinBound ? "heights within AVL bound" : "HEIGHT BOUND EXCEEDED") << endl;
+
+  return withinBound ? 0 : 1;
+}
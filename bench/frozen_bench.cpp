@@ -0,0 +1,78 @@
+/*frozen_bench.cpp*/
+
+//
+// Random-lookup latency of a live avlt against its freeze() copy, for
+// several tree sizes.  Half the lookups hit, half are random keys that
+// mostly miss.  The default sizes are 1K, 1M and 10M keys; pass sizes
+// on the command line for more (100M int keys need roughly 5 GB for
+// the live tree and the frozen copy together).
+//
+// Build: g++ -std=c++17 -O2 -I.. frozen_bench.cpp -o frozen_bench
+// Usage: ./frozen_bench [N ...]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include "frozen_avlt.h"
+
+using namespace std;
+
+template<typename Tree>
+double lookupNs(const Tree& tree, const vector<int>& probes, long long& sum)
+{
+  auto t0 = chrono::steady_clock::now();
+
+  for(int k : probes)
+  {
+    int value;
+    if(tree.search(k, value))
+      sum += value;
+  }
+
+  auto t1 = chrono::steady_clock::now();
+  return chrono::duration<double, nano>(t1 - t0).count() / probes.size();
+}
+
+int main(int argc, char* argv[])
+{
+  vector<int> sizes;
+  for(int i = 1; i < argc; i++)
+    sizes.push_back(atoi(argv[i]));
+
+  if(sizes.empty())
+    sizes = {1000, 1000000, 10000000};
+
+  const int lookups = 2000000;
+  mt19937 rng(251);
+
+  for(int N : sizes)
+  {
+    vector<pair<int, int>> pairs(N);
+    for(int i = 0; i < N; i++)
+      pairs[i] = make_pair((int)(rng() & 0x3fffffff), i);
+
+    avlt<int, int> tree;
+    tree.assign_sorted(pairs.begin(), pairs.end());  // Sorts the random keys
+
+    auto t0 = chrono::steady_clock::now();
+    frozen_avlt<int, int> frozen = tree.freeze();
+    auto t1 = chrono::steady_clock::now();
+
+    vector<int> probes(lookups);
+    for(int i = 0; i < lookups; i++)
+      probes[i] = (i % 2 == 0) ? pairs[rng() % N].first : (int)(rng() & 0x3fffffff);
+
+    long long liveSum = 0, frozenSum = 0;
+    double liveNs = lookupNs(tree, probes, liveSum);
+    double frozenNs = lookupNs(frozen, probes, frozenSum);
+
+    cout << "N=" << N << ": freeze " << chrono::duration<double, milli>(t1 - t0).count()
+         << " ms, live " << liveNs << " ns/lookup, frozen " << frozenNs
+         << " ns/lookup, speedup " << liveNs / frozenNs
+         << ((liveSum == frozenSum) ? "" : "  MISMATCH") << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,82 @@
+/*image_bench.cpp*/
+
+//
+// Startup cost of a tree of N int keys: rebuilding it with insert(),
+// loading a saved image with load(), and mapping the image with
+// avlt_image; then random lookups on the loaded tree and on the map.
+//
+// Build: g++ -std=c++17 -O2 -I.. image_bench.cpp -o image_bench
+// Usage: ./image_bench [N] [lookups] [image file]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include "avlt_image.h"
+
+using namespace std;
+
+template<typename Tree>
+double lookupNs(const Tree& tree, const vector<int>& probes, long long& hits)
+{
+  auto t0 = chrono::steady_clock::now();
+
+  for(int k : probes)
+  {
+    int value;
+    hits += tree.search(k, value);
+  }
+
+  auto t1 = chrono::steady_clock::now();
+  return chrono::duration<double, nano>(t1 - t0).count() / probes.size();
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 4000000;
+  int lookups = (argc > 2) ? atoi(argv[2]) : 2000000;
+  string path = (argc > 3) ? argv[3] : "image_bench.avlt";
+
+  mt19937 rng(251);
+  vector<int> keys(N);
+  for(int i = 0; i < N; i++)
+    keys[i] = (int)(rng() & 0x3fffffff);
+
+  auto t0 = chrono::steady_clock::now();
+  avlt<int, int> built;
+  for(int i = 0; i < N; i++)
+    built.insert(keys[i], i);
+
+  auto t1 = chrono::steady_clock::now();
+  built.save(path);
+
+  auto t2 = chrono::steady_clock::now();
+  avlt<int, int> loaded;
+  loaded.load(path);
+
+  auto t3 = chrono::steady_clock::now();
+  avlt_image<int, int> mapped(path);
+
+  auto t4 = chrono::steady_clock::now();
+
+  cout << "N=" << N << " (" << built.size() << " distinct)" << endl;
+  cout << "  insert loop: " << chrono::duration<double, milli>(t1 - t0).count() << " ms" << endl;
+  cout << "  save:        " << chrono::duration<double, milli>(t2 - t1).count() << " ms" << endl;
+  cout << "  load:        " << chrono::duration<double, milli>(t3 - t2).count() << " ms" << endl;
+  cout << "  mmap open:   " << chrono::duration<double, milli>(t4 - t3).count() << " ms" << endl;
+
+  vector<int> probes(lookups);
+  for(int i = 0; i < lookups; i++)
+    probes[i] = (i % 2 == 0) ? keys[rng() % N] : (int)(rng() & 0x3fffffff);
+
+  long long h1 = 0, h2 = 0;
+  double treeNs = lookupNs(loaded, probes, h1);
+  double mapNs = lookupNs(mapped, probes, h2);
+
+  cout << "  lookups: loaded tree " << treeNs << " ns, mapped image " << mapNs << " ns"
+       << ((h1 == h2 && loaded.size() == mapped.size()) ? "" : "  MISMATCH") << endl;
+
+  remove(path.c_str());
+  return 0;
+}
@@ -0,0 +1,87 @@
+/*insert_alloc_bench.cpp*/
+
+//
+// Counts heap allocations made by insert().  Global operator new is
+// replaced with a counting version; with avlt_new_alloc every insert
+// of a new key must allocate exactly once (the node), and with
+// avlt_pool only when a new block is needed.  Exits with 1 if insert
+// allocates anything beyond that.
+//
+// Build: g++ -std=c++17 -O2 -I.. insert_alloc_bench.cpp -o insert_alloc_bench
+// Usage: ./insert_alloc_bench [N]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include "avlt.h"
+
+using namespace std;
+
+static long long Allocations = 0;  // # of calls to operator new
+
+void* operator new(size_t bytes)
+{
+  Allocations++;
+
+  void* p = malloc(bytes == 0 ? 1 : bytes);
+  if(p == nullptr)
+    throw bad_alloc();
+
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+template<template<typename> class NodeAlloc>
+long long run(const char* name, const vector<int>& keys)
+{
+  avlt<int, int, NodeAlloc> tree;
+
+  long long before = Allocations;
+  auto t0 = chrono::steady_clock::now();
+
+  for(int k : keys)
+    tree.insert(k, k);
+
+  auto t1 = chrono::steady_clock::now();
+  long long allocs = Allocations - before;
+
+  cout << name << ": " << tree.size() << " inserts, " << allocs
+       << " heap allocations, "
+       << chrono::duration<double, milli>(t1 - t0).count() << " ms" << endl;
+
+  return allocs - tree.size();  // Allocations beyond one per node
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 1000000;
+
+  vector<int> keys(N);
+  for(int i = 0; i < N; i++)
+    keys[i] = i;
+
+  shuffle(keys.begin(), keys.end(), mt19937(251));
+
+  long long extraNew = run<avlt_new_alloc>("new/delete", keys);
+  run<avlt_pool>("pool      ", keys);
+
+  if(extraNew != 0)
+  {
+    cout << "insert made " << extraNew << " allocations besides its nodes" << endl;
+    return 1;
+  }
+
+  cout << "insert made no allocations besides its nodes" << endl;
+  return 0;
+}
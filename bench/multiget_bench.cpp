@@ -0,0 +1,66 @@
+/*multiget_bench.cpp*/
+
+//
+// Multi-get throughput: requests of B random keys (half present) are
+// resolved against a tree of N keys, by a loop of search() and by one
+// search_batch() per request.  Pick N so the tree is well past the
+// last-level cache (the default 8M int nodes take about 256 MB).
+//
+// Build: g++ -std=c++17 -O2 -I.. multiget_bench.cpp -o multiget_bench
+// Usage: ./multiget_bench [N] [keys per request] [requests]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include "avlt.h"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 8000000;
+  int B = (argc > 2) ? atoi(argv[2]) : 1000;
+  int requests = (argc > 3) ? atoi(argv[3]) : 1000;
+
+  mt19937 rng(251);
+  vector<pair<int, int>> pairs(N);
+  for(int i = 0; i < N; i++)
+    pairs[i] = make_pair((int)(rng() & 0x3fffffff), i);
+
+  avlt<int, int> tree;
+  tree.assign_sorted(pairs.begin(), pairs.end());
+
+  vector<int> keys((size_t)B * requests);
+  for(size_t i = 0; i < keys.size(); i++)
+    keys[i] = (i % 2 == 0) ? pairs[rng() % N].first : (int)(rng() & 0x3fffffff);
+
+  vector<int> values(B);
+  unique_ptr<bool[]> found(new bool[B]);
+  long long loopHits = 0, batchHits = 0;
+
+  auto t0 = chrono::steady_clock::now();
+  for(int r = 0; r < requests; r++)
+  {
+    const int* request = &keys[(size_t)r * B];
+    for(int i = 0; i < B; i++)
+      loopHits += tree.search(request[i], values[i]);
+  }
+
+  auto t1 = chrono::steady_clock::now();
+  for(int r = 0; r < requests; r++)
+    batchHits += tree.search_batch(&keys[(size_t)r * B], B, values.data(), found.get());
+
+  auto t2 = chrono::steady_clock::now();
+
+  double loopS = chrono::duration<double>(t1 - t0).count();
+  double batchS = chrono::duration<double>(t2 - t1).count();
+  double total = (double)B * requests;
+
+  cout << "N=" << N << ", " << B << " keys/request: search loop " << total / loopS / 1e6
+       << " M lookups/s, search_batch " << total / batchS / 1e6 << " M lookups/s, speedup "
+       << loopS / batchS << ((loopHits == batchHits) ? "" : "  MISMATCH") << endl;
+
+  return 0;
+}
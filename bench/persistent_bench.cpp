@@ -0,0 +1,113 @@
+/*persistent_bench.cpp*/
+
+//
+// Cost of keeping V versions of a tree of N keys, each one insert
+// newer than the last: path copying with persistent_avlt against a
+// full copy of an avlt per version, plus lookups on an old version.
+//
+// Build: g++ -std=c++17 -O2 -I.. persistent_bench.cpp -o persistent_bench
+// Usage: ./persistent_bench [N] [versions] [avlt copies]
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "avlt.h"
+#include "persistent_avlt.h"
+
+using namespace std;
+
+// Resident memory in MB, from /proc (Linux); 0 elsewhere
+double residentMb()
+{
+  FILE* f = fopen("/proc/self/statm", "r");
+  long pages = 0, resident = 0;
+
+  if(f != nullptr)
+  {
+    if(fscanf(f, "%ld %ld", &pages, &resident) != 2)
+      resident = 0;
+
+    fclose(f);
+  }
+
+  return resident * 4096.0 / (1 << 20);
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 1000000;
+  int V = (argc > 2) ? atoi(argv[2]) : 100000;
+  int copies = (argc > 3) ? atoi(argv[3]) : 20;
+
+  mt19937 rng(251);
+  vector<pair<int, int>> pairs(N);
+  for(int i = 0; i < N; i++)
+    pairs[i] = make_pair(2 * i, i);
+
+  avlt<int, int> tree(pairs.begin(), pairs.end());
+  persistent_avlt<int, int> base(pairs.begin(), pairs.end());
+
+  /* V versions by path copying */
+  double before = residentMb();
+  vector<persistent_avlt<int, int>> versions;
+  versions.reserve(V + 1);
+  versions.push_back(base);
+
+  auto t0 = chrono::steady_clock::now();
+  for(int v = 0; v < V; v++)
+    versions.push_back(versions.back().insert(2 * (int)(rng() % N) + 1, v));
+
+  auto t1 = chrono::steady_clock::now();
+  double persistentUs = chrono::duration<double, micro>(t1 - t0).count() / V;
+  double persistentMb = residentMb() - before;
+
+  /* A few versions by copying the whole avlt */
+  vector<avlt<int, int>> copied;
+  copied.reserve(copies);
+
+  auto t2 = chrono::steady_clock::now();
+  for(int v = 0; v < copies; v++)
+  {
+    copied.push_back(v == 0 ? tree : copied.back());
+    copied.back().insert(2 * (int)(rng() % N) + 1, v);
+  }
+
+  auto t3 = chrono::steady_clock::now();
+  double copyUs = chrono::duration<double, micro>(t3 - t2).count() / copies;
+
+  /* Lookups on the oldest and the newest versions */
+  vector<int> probes(1000000);
+  for(int& p : probes)
+    p = (int)(rng() % (2 * N));
+
+  long long hits = 0;
+  auto t4 = chrono::steady_clock::now();
+  for(int p : probes)
+  {
+    int value;
+    hits += versions.front().search(p, value) + versions.back().search(p, value);
+  }
+
+  auto t5 = chrono::steady_clock::now();
+  for(int p : probes)
+  {
+    int value;
+    hits += tree.search(p, value) + tree.search(p, value);
+  }
+
+  auto t6 = chrono::steady_clock::now();
+  double versionNs = chrono::duration<double, nano>(t5 - t4).count() / (2 * probes.size());
+  double treeNs = chrono::duration<double, nano>(t6 - t5).count() / (2 * probes.size());
+
+  cout << "N=" << N << ", " << V << " versions" << endl;
+  cout << "  persistent_avlt: " << persistentUs << " us and "
+       << persistentMb * 1024 * 1024 / V << " bytes per version" << endl;
+  cout << "  avlt copy:       " << copyUs << " us per version (" << copies << " copies)" << endl;
+  cout << "  lookups: old/new version " << versionNs << " ns, avlt " << treeNs << " ns"
+       << " (" << hits << " hits)" << endl;
+
+  return 0;
+}
@@ -0,0 +1,97 @@
+/*range_bench.cpp*/
+
+//
+// Paginated range queries: fetch pages of (key, value) pairs starting at
+// random keys.  Compares range_search() keys followed by one search()
+// per key against range_search() into an output iterator with a limit,
+// and against a range_for_each() visitor that stops early.
+//
+// Build: g++ -std=c++17 -O2 -I.. range_bench.cpp -o range_bench
+// Usage: ./range_bench [N] [queries] [page size]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include "avlt.h"
+
+using namespace std;
+
+template<typename F>
+void measure(const char* name, int queries, F f)
+{
+  auto t0 = chrono::steady_clock::now();
+  long long sum = f();
+  auto t1 = chrono::steady_clock::now();
+
+  double secs = chrono::duration<double>(t1 - t0).count();
+  cout << name << ": " << queries / secs << " pages/s (checksum " << sum << ")" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 1000000;
+  int queries = (argc > 2) ? atoi(argv[2]) : 100000;
+  int page = (argc > 3) ? atoi(argv[3]) : 50;
+
+  mt19937 rng(251);
+  vector<pair<int, int>> pairs(N);
+  for(int i = 0; i < N; i++)
+    pairs[i] = make_pair(2 * i, i);
+
+  const avlt<int, int> tree(pairs.begin(), pairs.end());
+
+  vector<int> starts(queries);
+  for(int& s : starts)
+    s = (int)(rng() % (2 * (unsigned)N));
+
+  /* The page spans "page" keys, since every other key is present */
+  measure("range_search + search  ", queries, [&]
+  {
+    long long sum = 0;
+    int value = 0;
+    for(int s : starts)
+    {
+      vector<int> keys = tree.range_search(s, s + 2 * page - 1);
+      for(int k : keys)
+      {
+        tree.search(k, value);
+        sum += value;
+      }
+    }
+    return sum;
+  });
+
+  vector<pair<int, int>> out;
+  out.reserve(page);
+  measure("range_search(out, limit)", queries, [&]
+  {
+    long long sum = 0;
+    for(int s : starts)
+    {
+      out.clear();
+      tree.range_search(s, s + 2 * page - 1, back_inserter(out), page);
+      for(auto& kv : out)
+        sum += kv.second;
+    }
+    return sum;
+  });
+
+  measure("range_for_each          ", queries, [&]
+  {
+    long long sum = 0;
+    for(int s : starts)
+    {
+      int left = page;
+      tree.range_for_each(s, s + 2 * page - 1, [&](const int&, const int& value)
+      {
+        sum += value;
+        return --left > 0;
+      });
+    }
+    return sum;
+  });
+
+  return 0;
+}
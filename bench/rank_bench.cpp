@@ -0,0 +1,82 @@
+/*rank_bench.cpp*/
+
+//
+// Counting keys in random ranges: range_search(...).size() on a plain
+// tree against count_range() on an order-statistic tree, plus rank()
+// and select() throughput.
+//
+// Build: g++ -std=c++17 -O2 -I.. rank_bench.cpp -o rank_bench
+// Usage: ./rank_bench [N] [queries] [range width]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include "avlt.h"
+
+using namespace std;
+
+template<typename F>
+void measure(const char* name, int queries, F f)
+{
+  auto t0 = chrono::steady_clock::now();
+  long long sum = f();
+  auto t1 = chrono::steady_clock::now();
+
+  double secs = chrono::duration<double>(t1 - t0).count();
+  cout << name << ": " << queries / secs << " queries/s (checksum " << sum << ")" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 1000000;
+  int queries = (argc > 2) ? atoi(argv[2]) : 10000;
+  int width = (argc > 3) ? atoi(argv[3]) : N / 10;
+
+  vector<pair<int, int>> pairs(N);
+  for(int i = 0; i < N; i++)
+    pairs[i] = make_pair(i, i);
+
+  const avlt<int, int> plain(pairs.begin(), pairs.end());
+  const avlt<int, int, avlt_pool, true> counted(pairs.begin(), pairs.end());
+
+  mt19937 rng(251);
+  vector<int> starts(queries);
+  for(int& s : starts)
+    s = (int)(rng() % (unsigned)N);
+
+  measure("range_search().size()", queries, [&]
+  {
+    long long sum = 0;
+    for(int s : starts)
+      sum += plain.range_search(s, s + width).size();
+    return sum;
+  });
+
+  measure("count_range()        ", queries, [&]
+  {
+    long long sum = 0;
+    for(int s : starts)
+      sum += counted.count_range(s, s + width);
+    return sum;
+  });
+
+  measure("rank()               ", queries, [&]
+  {
+    long long sum = 0;
+    for(int s : starts)
+      sum += counted.rank(s);
+    return sum;
+  });
+
+  measure("select()             ", queries, [&]
+  {
+    long long sum = 0;
+    for(int s : starts)
+      sum += counted.select(s).key();
+    return sum;
+  });
+
+  return 0;
+}
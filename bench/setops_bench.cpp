@@ -0,0 +1,94 @@
+/*setops_bench.cpp*/
+
+//
+// Merging a delta tree of M keys into a base tree of N keys: insert()
+// in a loop against unite(), and intersect() / subtract() as well, on
+// 1, 2, 4, ... threads up to the # of cores.  Half the delta's keys are
+// already in the base.
+//
+// Build: g++ -std=c++17 -O2 -pthread -I.. setops_bench.cpp -o setops_bench
+// Usage: ./setops_bench [N] [M] [max threads]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+#include "avlt.h"
+
+using namespace std;
+
+typedef avlt<int, int> TREE;
+
+// Seconds taken by op(base, delta), run on fresh copies of both trees
+template<typename Op>
+double timed(const TREE& base, const TREE& delta, Op op)
+{
+  TREE a, b;
+  a.copy_from(base);
+  b.copy_from(delta);
+
+  auto t0 = chrono::steady_clock::now();
+  op(a, b);
+  auto t1 = chrono::steady_clock::now();
+
+  return chrono::duration<double>(t1 - t0).count();
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 10000000;
+  int M = (argc > 2) ? atoi(argv[2]) : 10000000;
+  int maxThreads = (argc > 3) ? atoi(argv[3]) : (int)thread::hardware_concurrency();
+
+  mt19937 rng(251);
+  vector<pair<int, int>> pairs(N);
+  for(int i = 0; i < N; i++)
+    pairs[i] = make_pair(2 * i, i);
+
+  TREE base(pairs.begin(), pairs.end());
+
+  /* Random delta keys over the same range, even ones (in base) and odd */
+  pairs.resize(M);
+  for(int i = 0; i < M; i++)
+    pairs[i] = make_pair((int)(rng() % (2 * (unsigned)N)), i);
+
+  TREE delta;
+  delta.insert_batch(pairs.begin(), pairs.end());
+
+  cout << "N=" << N << ", M=" << M << " (" << delta.size() << " distinct)" << endl;
+
+  double loop = timed(base, delta, [](TREE& a, TREE& b)
+  {
+    int key = 0, value = 0;
+
+    for(b.begin(); b.next(key); )
+    {
+      b.search(key, value);
+      a.insert(key, value);
+    }
+  });
+
+  cout << "  insert loop:        " << loop << " s" << endl;
+
+  for(int threads = 1; threads <= max(maxThreads, 1); threads *= 2)
+  {
+    int size = 0;
+
+    double unite = timed(base, delta, [&](TREE& a, TREE& b)
+    {
+      a.unite(b, threads);
+      size = a.size();
+    });
+
+    double intersect = timed(base, delta, [&](TREE& a, TREE& b) { a.intersect(b, threads); });
+    double subtract = timed(base, delta, [&](TREE& a, TREE& b) { a.subtract(b, threads); });
+
+    cout << "  " << threads << " thread(s): unite " << unite << " s (x" << loop / unite
+         << ", " << size << " keys), intersect " << intersect << " s, subtract "
+         << subtract << " s" << endl;
+  }
+
+  return 0;
+}
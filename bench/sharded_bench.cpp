@@ -0,0 +1,90 @@
+/*sharded_bench.cpp*/
+
+//
+// Aggregate throughput of one avlt against a sharded_avlt with one shard
+// per thread: bulk loading random keys (a loop of insert() against
+// insert_parallel()) and random lookups from T threads at once.
+//
+// Build: g++ -std=c++17 -O2 -pthread -I.. sharded_bench.cpp -o sharded_bench
+// Usage: ./sharded_bench [N] [threads]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+#include "sharded_avlt.h"
+
+using namespace std;
+
+/* Runs search(key) for every key on "threads" threads at
+ * once, returning the total # of lookups per second */
+template<typename Search>
+double lookups(int threads, const vector<pair<int, int>>& pairs, Search search)
+{
+  vector<thread> pool;
+  auto t0 = chrono::steady_clock::now();
+
+  for(int t = 0; t < threads; t++)
+  {
+    pool.push_back(thread([&, t]
+    {
+      for(size_t i = t; i < pairs.size(); i += threads)
+        search(pairs[i].first);
+    }));
+  }
+
+  for(thread& t : pool)
+    t.join();
+
+  auto t1 = chrono::steady_clock::now();
+  return pairs.size() / chrono::duration<double>(t1 - t0).count();
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 2000000;
+  int threads = (argc > 2) ? atoi(argv[2]) : max(1, (int)thread::hardware_concurrency());
+
+  mt19937 rng(251);
+  vector<pair<int, int>> pairs(N);
+  for(auto& kv : pairs)
+    kv = make_pair((int)(rng() & 0x7fffffff), 0);
+
+  vector<int> samples;
+  for(int i = 0; i < 10000; i++)
+    samples.push_back(pairs[rng() % N].first);
+
+  avlt<int, int> single;
+  auto t0 = chrono::steady_clock::now();
+  for(auto& kv : pairs)
+    single.insert(kv.first, kv.second);
+  auto t1 = chrono::steady_clock::now();
+
+  sharded_avlt<int, int> sharded(samples, threads);
+  auto t2 = chrono::steady_clock::now();
+  sharded.insert_parallel(pairs.begin(), pairs.end(), threads);
+  auto t3 = chrono::steady_clock::now();
+
+  cout << "load   : single " << N / chrono::duration<double>(t1 - t0).count()
+       << " inserts/s, sharded (" << sharded.shard_count() << " shards) "
+       << N / chrono::duration<double>(t3 - t2).count() << " inserts/s" << endl;
+
+  double singleRate = lookups(threads, pairs, [&](int key)
+  {
+    int value;
+    single.search(key, value);
+  });
+
+  double shardedRate = lookups(threads, pairs, [&](int key)
+  {
+    int value;
+    sharded.search(key, value);
+  });
+
+  cout << "search : single " << singleRate << " lookups/s, sharded "
+       << shardedRate << " lookups/s (" << threads << " threads)" << endl;
+
+  return 0;
+}
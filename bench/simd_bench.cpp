@@ -0,0 +1,103 @@
+/*simd_bench.cpp*/
+
+//
+// Hit and miss lookup latency of frozen_avlt with int and long long
+// keys, where the block search of frozen_simd.h kicks in, against the
+// scalar Eytzinger search (the same keys wrapped in a struct, which
+// frozen_simd does not know) and against the live avlt.  Above
+// frozen_simd's max_keys, frozen_avlt falls back on the scalar search,
+// so both columns time the same code there.
+//
+// Build: g++ -std=c++17 -O2 -I.. simd_bench.cpp -o simd_bench
+// Usage: ./simd_bench [N] [lookups]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include "frozen_avlt.h"
+
+using namespace std;
+
+// An integer that is not an int, so frozen_avlt uses its scalar search
+template<typename T>
+struct boxed
+{
+  T v;
+
+  bool operator<(const boxed& other) const
+  {
+    return v < other.v;
+  }
+
+  bool operator==(const boxed& other) const
+  {
+    return v == other.v;
+  }
+};
+
+template<typename Tree, typename K>
+double lookupNs(const Tree& tree, const vector<K>& probes, long long& hits)
+{
+  auto t0 = chrono::steady_clock::now();
+
+  for(const K& k : probes)
+  {
+    int value;
+    hits += tree.search(k, value);
+  }
+
+  auto t1 = chrono::steady_clock::now();
+  return chrono::duration<double, nano>(t1 - t0).count() / probes.size();
+}
+
+template<typename T>
+void run(const char* type, int N, int lookups, mt19937_64& rng)
+{
+  /* Even keys are in the tree, odd keys miss */
+  vector<pair<T, int>> pairs(N);
+  vector<pair<boxed<T>, int>> boxedPairs(N);
+  for(int i = 0; i < N; i++)
+  {
+    pairs[i] = make_pair((T)(rng() >> 34) * 2, i);
+    boxedPairs[i] = make_pair(boxed<T>{pairs[i].first}, i);
+  }
+
+  avlt<T, int> live(pairs.begin(), pairs.end());
+  avlt<boxed<T>, int> boxedLive(boxedPairs.begin(), boxedPairs.end());
+  frozen_avlt<T, int> frozen = live.freeze();
+  frozen_avlt<boxed<T>, int> scalar = boxedLive.freeze();
+
+  for(bool hit : {true, false})
+  {
+    vector<T> probes(lookups);
+    vector<boxed<T>> boxedProbes(lookups);
+    for(int i = 0; i < lookups; i++)
+    {
+      probes[i] = hit ? pairs[rng() % N].first : (T)(rng() >> 34) * 2 + 1;
+      boxedProbes[i] = boxed<T>{probes[i]};
+    }
+
+    long long h1 = 0, h2 = 0, h3 = 0;
+    double simdNs = lookupNs(frozen, probes, h1);
+    double scalarNs = lookupNs(scalar, boxedProbes, h2);
+    double liveNs = lookupNs(live, probes, h3);
+
+    cout << type << ", N=" << N << (hit ? ", hits:   " : ", misses: ") << "block search "
+         << simdNs << " ns, scalar frozen " << scalarNs << " ns, live avlt " << liveNs
+         << " ns" << ((h1 == h2 && h2 == h3) ? "" : "  MISMATCH") << endl;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 1000000;
+  int lookups = (argc > 2) ? atoi(argv[2]) : 2000000;
+
+  mt19937_64 rng(251);
+  run<int>("int      ", N, lookups, rng);
+  run<long long>("long long", N, lookups, rng);
+
+  return 0;
+}
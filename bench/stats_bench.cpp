@@ -0,0 +1,78 @@
+/*stats_bench.cpp*/
+
+//
+// What avlt_stats reports for N inserts and N searches in sequential
+// and random key order, and what keeping the counters costs next to
+// the default avlt_no_stats.
+//
+// Build: g++ -std=c++17 -O2 -I.. stats_bench.cpp -o stats_bench
+// Usage: ./stats_bench [N]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#include "avlt.h"
+
+using namespace std;
+
+template<typename Tree>
+double run(Tree& tree, const vector<int>& keys)
+{
+  auto t0 = chrono::steady_clock::now();
+
+  for(size_t i = 0; i < keys.size(); i++)
+    tree.insert(keys[i], (int)i);
+
+  long long hits = 0;
+  for(int k : keys)
+  {
+    int value;
+    hits += tree.search(k, value);
+  }
+
+  auto t1 = chrono::steady_clock::now();
+  return (hits == (long long)tree.size()) ? chrono::duration<double, milli>(t1 - t0).count() : -1;
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 1000000;
+
+  mt19937 rng(251);
+  vector<int> sequential(N), random(N);
+  for(int i = 0; i < N; i++)
+    sequential[i] = random[i] = i;
+
+  shuffle(random.begin(), random.end(), rng);
+
+  for(const vector<int>* keys : {&sequential, &random})
+  {
+    avlt<int, int> plain;
+    avlt<int, int, avlt_pool, false, avlt_stats> counted;
+
+    double plainMs = run(plain, *keys);
+    double countedMs = run(counted, *keys);
+    avlt_stats_snapshot s = counted.stats();
+
+    cout << ((keys == &sequential) ? "sequential" : "random") << ", N=" << N << ": "
+         << plainMs << " ms without stats, " << countedMs << " ms with" << endl;
+    cout << "  comparisons per insert " << (double)s.InsertComparisons / s.Inserts
+         << ", per search " << (double)s.SearchComparisons / s.Searches << endl;
+    cout << "  rotations: " << s.SingleRotations << " single, " << s.DoubleRotations
+         << " double; retrace steps per insert " << (double)s.RetraceSteps / s.Inserts << endl;
+    cout << "  allocations " << s.Allocations << ", frees " << s.Frees << endl;
+    cout << "  depth histogram:";
+
+    for(int d = 0; d < avlt_stats_snapshot::MaxDepth; d++)
+    {
+      if(s.Depth[d] != 0)
+        cout << " " << d << ":" << s.Depth[d];
+    }
+
+    cout << endl;
+  }
+
+  return 0;
+}
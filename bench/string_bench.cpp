@@ -0,0 +1,131 @@
+/*string_bench.cpp*/
+
+//
+// String-key workload: counts heap allocations (global operator new is
+// replaced with a counting version) and time for inserting by copy,
+// by move and with try_emplace, and for lookups through search(),
+// operator[] and operator%.  Keys are long enough to defeat the small
+// string optimization, so every key copy shows up as an allocation.
+//
+// Build: g++ -std=c++17 -O2 -I.. string_bench.cpp -o string_bench
+// Usage: ./string_bench [N]
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include "avlt.h"
+
+using namespace std;
+
+static long long Allocations = 0;  // # of calls to operator new
+
+void* operator new(size_t bytes)
+{
+  Allocations++;
+
+  void* p = malloc(bytes == 0 ? 1 : bytes);
+  if(p == nullptr)
+    throw bad_alloc();
+
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+struct PAYLOAD
+{
+  string Name;
+  double Data[8];
+};
+
+template<typename F>
+void measure(const char* name, int N, F f)
+{
+  long long before = Allocations;
+  auto t0 = chrono::steady_clock::now();
+
+  f();
+
+  auto t1 = chrono::steady_clock::now();
+  cout << name << ": " << chrono::duration<double, milli>(t1 - t0).count()
+       << " ms, " << (double)(Allocations - before) / N
+       << " allocations/op" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  int N = (argc > 1) ? atoi(argv[1]) : 200000;
+
+  vector<string> keys(N);
+  mt19937 rng(251);
+  for(string& k : keys)
+    k = "customer/account/" + to_string(rng()) + "/" + to_string(rng());
+
+  PAYLOAD payload{string(40, 'p'), {0}};
+
+  {
+    avlt<string, PAYLOAD> tree;
+    measure("insert (copy)       ", N, [&]
+    {
+      for(const string& k : keys)
+        tree.insert(k, payload);
+    });
+  }
+
+  {
+    avlt<string, PAYLOAD> tree;
+    vector<string> moved = keys;
+    measure("insert (move)       ", N, [&]
+    {
+      for(string& k : moved)
+        tree.insert(std::move(k), PAYLOAD{string(40, 'p'), {0}});
+    });
+  }
+
+  avlt<string, PAYLOAD> tree;
+  measure("try_emplace         ", N, [&]
+  {
+    for(const string& k : keys)
+      tree.try_emplace(k, payload);
+  });
+
+  measure("try_emplace (dups)  ", N, [&]
+  {
+    for(const string& k : keys)
+      tree.try_emplace(k, payload);
+  });
+
+  PAYLOAD value;
+  long long found = 0;
+  measure("search              ", N, [&]
+  {
+    for(const string& k : keys)
+      found += tree.search(k, value);
+  });
+
+  measure("operator%           ", N, [&]
+  {
+    for(const string& k : keys)
+      found += (tree % k) >= 0;
+  });
+
+  measure("operator[]          ", N, [&]
+  {
+    for(const string& k : keys)
+      found += tree[k].Data[0] == 0;
+  });
+
+  cout << "(" << found << " found)" << endl;
+  return 0;
+}
@@ -0,0 +1,1196 @@
+/*compact_avlt.h*/
+
+//
+// Threaded AVL tree with a compact node layout: 32-bit links, packed
+// height and thread bits, all nodes in one array.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//
+// compact_avlt
+//
+// The same tree as avlt, with a smaller node, and the core of avlt's
+// public API: insert, erase, search, [], (), %, range_search,
+// range_for_each, begin/next, const iterators with find, lower_bound
+// and upper_bound, size, height, clear, swap and dump, all behaving as
+// in avlt (dump() prints the same tree).
+//
+// An avlt node spends two 64-bit pointers, a bool and an int on
+// bookkeeping, 24 bytes with padding; here every node lives in one
+// contiguous array and links are 32-bit slot numbers, with the height
+// and the thread flag packed into the top bits of the two links.  A
+// node of int keys and int values shrinks from 32 to 16 bytes, so twice
+// as many fit in a cache line and lookups miss less.
+//
+// Link layout (slot 0 means "no node", like nullptr):
+//
+//    Left:   [ height bits 0-3 | left slot (28 bits) ]
+//    Right:  [ thread | unused | height bits 4-5 | right slot (28 bits) ]
+//
+// which allows up to 2^28 - 1 (about 268 million) nodes; heights never
+// exceed 43, which needs 6 bits.  Slot numbers, unlike pointers, stay
+// put when the array grows, so iterators survive inserts.
+//
+// Not carried over from avlt, so code written against avlt does not
+// always compile against compact_avlt:
+//
+//    - the NodeAlloc, OrderStats, Stats and Compare template
+//      parameters: the node array is the allocator, keys are ordered
+//      by operator<, and there is no rank, select, count_range or
+//      stats()
+//    - emplace, try_emplace, insert by move, push_back, insert_hint,
+//      insert_batch, assign_sorted and the range constructor
+//    - the output-iterator range_search, range_for_each_open,
+//      range_for_each_reverse and search_batch
+//    - lookups by a key type other than KeyT
+//    - join, split, unite, intersect, subtract, copy_from, save, load
+//      and freeze
+//
+// The rotation, rebalancing and erase code is avlt's, rewritten for
+// slot numbers; a change to one must be made to the other.
+//
+template<typename KeyT, typename ValueT>
+class compact_avlt
+{
+private:
+  typedef uint32_t INDEX;  // slot of a node in Nodes, 0 => no node
+
+  struct NODE
+  {
+    KeyT     Key;
+    ValueT   Value;
+    uint32_t Left;   // left slot, low bits of the height
+    uint32_t Right;  // right slot or thread, high bits of the height, thread flag
+  };
+
+  static const int      IndexBits = 28;
+  static const uint32_t IndexMask = (1u << IndexBits) - 1;
+  static const uint32_t ThreadBit = 1u << 31;
+
+  // Largest # of nodes, since slot 0 is never used
+  static const INDEX MaxNodes = IndexMask;
+
+  // Largest height an AVL tree can reach while its size fits in an
+  // int.  A root-to-leaf path holds at most MaxHeight+1 nodes.
+  static const int MaxHeight = 43;
+
+  NODE* Nodes;     // node array, slot i at Nodes[i] (Nodes[0] unused)
+  INDEX Capacity;  // # of slots in Nodes, slot 0 included
+  INDEX Used;      // # of slots ever handed out, slot 0 included
+  INDEX FreeList;  // erased slots, linked through their first bytes
+  INDEX Root;      // slot of the root (0 if empty)
+  INDEX Current;   // slot of current node for begin and next functions
+  int   Size;      // # of nodes in the tree (0 if empty)
+
+
+	/* Link and height accessors */
+	static INDEX _left(const NODE& n)
+	{
+		return n.Left & IndexMask;
+	}
+
+	static INDEX _right(const NODE& n)
+	{
+		return n.Right & IndexMask;
+	}
+
+	static bool _threaded(const NODE& n)
+	{
+		return (n.Right & ThreadBit) != 0;
+	}
+
+	static int _height(const NODE& n)
+	{
+		return (int)((n.Left >> IndexBits) | (((n.Right >> IndexBits) & 3u) << 4));
+	}
+
+	static void _setLeft(NODE& n, INDEX i)
+	{
+		n.Left = (n.Left & ~IndexMask) | i;
+	}
+
+	static void _setRight(NODE& n, INDEX i, bool threaded)
+	{
+		n.Right = (n.Right & ~(IndexMask | ThreadBit)) | i | (threaded ? ThreadBit : 0u);
+	}
+
+	static void _setHeight(NODE& n, int h)
+	{
+		n.Left = (n.Left & IndexMask) | ((uint32_t)(h & 15) << IndexBits);
+		n.Right = (n.Right & ~(3u << IndexBits)) | ((uint32_t)(h >> 4) << IndexBits);
+	}
+
+	/* Height of the subtree in slot i, -1 if there is none */
+	int _heightOf(INDEX i) const
+	{
+		return (i == 0) ? -1 : _height(Nodes[i]);
+	}
+
+	/* Right child of a node, 0 when its Right is a thread */
+	static INDEX _child(const NODE& n)
+	{
+		return _threaded(n) ? 0 : _right(n);
+	}
+
+
+	/* Calls f(slot) for every node in the tree, in order */
+	template<typename F>
+	void _forEach(F f) const
+	{
+		for(INDEX i = _begin(Root); i != 0; i = _next(i))
+			f(i);
+	}
+
+
+	/* Moves the nodes into a new array of the given # of
+	 * slots.  Nodes keep their slot numbers, so no link
+	 * changes; erased slots keep their free list links. */
+	void _resize(INDEX slots)
+	{
+		NODE* nodes = static_cast<NODE*>(::operator new((size_t)slots * sizeof(NODE)));
+
+		if constexpr (is_trivially_copyable<NODE>::value)
+		{
+			if(Used > 1)
+				memcpy(nodes + 1, Nodes + 1, (size_t)(Used - 1) * sizeof(NODE));
+		}
+		else
+		{
+			INDEX moved = 0;  // # of nodes constructed in the new array
+
+			try
+			{
+				_forEach([&](INDEX i)
+				{
+					new (&nodes[i]) NODE(std::move_if_noexcept(Nodes[i]));
+					moved++;
+				});
+			}
+			catch(...)  // A copy threw, undo the ones that were made
+			{
+				_forEach([&](INDEX i)
+				{
+					if(moved > 0)
+					{
+						nodes[i].~NODE();
+						moved--;
+					}
+				});
+
+				::operator delete(nodes);
+				throw;
+			}
+
+			_forEach([&](INDEX i)
+			{
+				Nodes[i].~NODE();
+			});
+
+			for(INDEX i = FreeList; i != 0; i = _freeNext(nodes, i))
+				memcpy(static_cast<void*>(&nodes[i]), &Nodes[i], sizeof(INDEX));
+		}
+
+		::operator delete(Nodes);
+		Nodes = nodes;
+		Capacity = slots;
+	}
+
+
+	/* Next slot on the free list, stored in the
+	 * first bytes of the erased slot */
+	static INDEX _freeNext(const NODE* nodes, INDEX i)
+	{
+		INDEX next;
+		memcpy(&next, &nodes[i], sizeof(INDEX));
+		return next;
+	}
+
+
+	/* Takes a slot from the free list, or a fresh
+	 * one, growing the array when it is full */
+	INDEX _allocate()
+	{
+		if(FreeList != 0)
+		{
+			INDEX i = FreeList;
+			FreeList = _freeNext(Nodes, i);
+			return i;
+		}
+
+		if(Used >= Capacity)  // Full, or nothing allocated yet
+		{
+			if(Capacity > MaxNodes)
+				throw length_error("compact_avlt: too many nodes");
+
+			/* Double the array, at most up to MaxNodes slots */
+			size_t slots = max<size_t>(64, (size_t)Capacity * 2);
+			_resize((INDEX)min<size_t>(slots, (size_t)MaxNodes + 1));
+		}
+
+		return Used++;
+	}
+
+
+	/* Allocates a slot and fills in a new leaf */
+	INDEX _newNode(const KeyT& key, const ValueT& value)
+	{
+		INDEX i = _allocate();
+
+		try
+		{
+			new (&Nodes[i]) NODE{key, value, 0, ThreadBit};
+		}
+		catch(...)  // Key or value copy threw, give the slot back:
+		{
+			memcpy(static_cast<void*>(&Nodes[i]), &FreeList, sizeof(INDEX));
+			FreeList = i;
+			throw;
+		}
+
+		return i;
+	}
+
+
+	/* Destroys a node and puts its
+	 * slot on the free list */
+	void _freeNode(INDEX i)
+	{
+		Nodes[i].~NODE();
+		memcpy(static_cast<void*>(&Nodes[i]), &FreeList, sizeof(INDEX));
+		FreeList = i;
+	}
+
+
+	/* Makes this (empty) tree an exact copy of the
+	 * other tree, slot for slot */
+	void _copy(const compact_avlt& other)
+	{
+		if(other.Used <= 1)  // Nothing to copy
+			return;
+
+		Nodes = static_cast<NODE*>(::operator new((size_t)other.Used * sizeof(NODE)));
+		Capacity = other.Used;
+
+		if constexpr (is_trivially_copyable<NODE>::value)
+			memcpy(Nodes + 1, other.Nodes + 1, (size_t)(other.Used - 1) * sizeof(NODE));
+		else
+		{
+			INDEX copied = 0;  // # of nodes constructed so far
+
+			try
+			{
+				other._forEach([&](INDEX i)
+				{
+					new (&Nodes[i]) NODE(other.Nodes[i]);
+					copied++;
+				});
+			}
+			catch(...)  // A copy threw, undo the ones that were made
+			{
+				other._forEach([&](INDEX i)
+				{
+					if(copied > 0)
+					{
+						Nodes[i].~NODE();
+						copied--;
+					}
+				});
+
+				::operator delete(Nodes);
+				Nodes = nullptr;
+				Capacity = 0;
+				throw;
+			}
+
+			for(INDEX i = other.FreeList; i != 0; i = _freeNext(other.Nodes, i))
+				memcpy(static_cast<void*>(&Nodes[i]), &other.Nodes[i], sizeof(INDEX));
+		}
+
+		Used = other.Used;
+		FreeList = other.FreeList;
+		Root = other.Root;
+		Size = other.Size;
+	}
+
+
+	/* Traverse through the tree using
+	 * inorder and print the nodes */
+	void _print(INDEX cur, ostream& output) const
+	{
+		if(cur == 0)  // Tree is empty or tree
+			return;   // has ended so return
+
+		const NODE& n = Nodes[cur];
+
+		_print(_left(n), output);  // Go Left
+
+		/* Print (Key, Value, Height, Thread) when node is threaded
+		 * and there is a node right of the current node.*/
+		if(_threaded(n) && _right(n) != 0)
+		{
+			output << "(" << n.Key << "," << n.Value << ","
+			       << _height(n) << "," << Nodes[_right(n)].Key << ")" << endl;
+		}
+		else
+		{
+			/* Print (Key, Value, Height) when node is not
+			 * threaded and go right to the next node */
+			output << "(" << n.Key << "," << n.Value << "," << _height(n) << ")" << endl;
+			_print(_child(n), output);  // Go Right
+		}
+	}
+
+
+	/* Points parent's link to old at sub instead,
+	 * or makes sub the root when there is no parent */
+	void _relink(INDEX parent, INDEX old, INDEX sub)
+	{
+		if(parent == 0)
+			Root = sub;
+		else if(_left(Nodes[parent]) == old)
+			_setLeft(Nodes[parent], sub);
+		else
+			_setRight(Nodes[parent], sub, false);
+	}
+
+
+	/* Rotates the subtree at n to the left
+	 * and updates the heights */
+	void _LeftRotate(INDEX parent, INDEX n)
+	{
+		NODE& N = Nodes[n];
+		INDEX r = _right(N);
+		NODE& R = Nodes[r];
+		INDEX a = _left(N);
+		INDEX b = _left(R);
+		INDEX c = _child(R);
+
+		// Make left rotation, N threads to R when B is empty:
+		_setLeft(R, n);
+		_setRight(N, (b == 0) ? r : b, b == 0);
+		_relink(parent, n, r);
+
+		_setHeight(N, 1 + max(_heightOf(a), _heightOf(b)));
+		_setHeight(R, 1 + max(_heightOf(c), _height(N)));
+	}
+
+
+	/* Rotates the subtree at n to the right
+	 * and updates the heights */
+	void _RightRotate(INDEX parent, INDEX n)
+	{
+		NODE& N = Nodes[n];
+		INDEX l = _left(N);
+		NODE& L = Nodes[l];
+		INDEX a = _left(L);
+		INDEX b = _child(L);
+		INDEX c = _child(N);
+
+		// Make right rotation and unthread:
+		_setRight(L, n, false);
+		_setLeft(N, b);
+		_relink(parent, n, l);
+
+		_setHeight(N, 1 + max(_heightOf(b), _heightOf(c)));
+		_setHeight(L, 1 + max(_heightOf(a), _height(N)));
+	}
+
+
+	/* Walks back up a search path (root first, count
+	 * nodes), updating heights and rotating wherever
+	 * the tree is broken.  Stops as soon as a subtree
+	 * keeps the height it had.  Same as avlt. */
+	void _rebalance(INDEX path[], int count)
+	{
+		for(int i = count - 1; i >= 0; i--)
+		{
+			INDEX cur = path[i];                          // Current node
+			INDEX parent = (i == 0) ? 0 : path[i - 1];   // Parent of the current node
+			NODE& C = Nodes[cur];
+
+			int hL = _heightOf(_left(C));
+			int hR = _heightOf(_child(C));
+			int hCur = 1 + max(hL, hR);
+
+			if(abs(hL - hR) <= 1)  // Balanced:
+			{
+				if(_height(C) == hCur)  // didn't change, so no need to go further:
+					break;
+
+				_setHeight(C, hCur);  // height changed, update and keep going
+				continue;
+			}
+
+			int  oldHeight = _height(C);  // Height before the update
+			bool isLeft = (parent != 0 && _left(Nodes[parent]) == cur);
+
+			if(hL > hR)  // Left is leaning:
+			{
+				const NODE& L = Nodes[_left(C)];
+
+				if(_heightOf(_left(L)) >= _heightOf(_child(L)))
+					_RightRotate(parent, cur);
+				else
+				{
+					_LeftRotate(cur, _left(C));
+					_RightRotate(parent, cur);
+				}
+			}
+			else  // Right is leaning:
+			{
+				const NODE& R = Nodes[_right(C)];
+
+				if(_heightOf(_child(R)) >= _heightOf(_left(R)))
+					_LeftRotate(parent, cur);
+				else
+				{
+					_RightRotate(cur, _right(C));
+					_LeftRotate(parent, cur);
+				}
+			}
+
+			/* Find the new root of this subtree */
+			INDEX sub;
+			if(parent == 0)
+				sub = Root;
+			else if(isLeft)
+				sub = _left(Nodes[parent]);
+			else
+				sub = _right(Nodes[parent]);
+
+			if(_height(Nodes[sub]) == oldHeight)  // Same height as before, done:
+				break;
+		}
+	}
+
+
+	/* Returns the slot that contains key,
+	 * or 0 if key is not in the tree */
+	INDEX _find(const KeyT& key) const
+	{
+		INDEX cur = Root;  // Current Node
+
+		while(cur != 0)
+		{
+			const NODE& n = Nodes[cur];
+
+			if(key == n.Key)  // Key found
+				return cur;
+
+			cur = (key < n.Key) ? _left(n) : _child(n);
+		}
+
+		return 0;
+	}
+
+
+	/* Searches for key, pushing every node visited
+	 * before it onto path.  Returns the slot holding
+	 * key, or 0 if key is not in the tree; then prev
+	 * is the node where we fell out of the tree */
+	INDEX _searchPath(const KeyT& key, INDEX path[], int& top, INDEX& prev) const
+	{
+		INDEX cur = Root;  // Current Node
+		prev = 0;          // Previous Node
+
+		while(cur != 0)
+		{
+			const NODE& n = Nodes[cur];
+
+			if(key == n.Key)  // Key already in tree
+				return cur;
+
+			path[top++] = cur;  // stack so we can return later
+			prev = cur;
+
+			cur = (key < n.Key) ? _left(n) : _child(n);
+		}
+
+		return 0;
+	}
+
+
+	/* Returns the leftmost slot
+	 * of the subtree at cur */
+	INDEX _begin(INDEX cur) const
+	{
+		if(cur == 0)
+			return 0;
+
+		while(_left(Nodes[cur]) != 0)
+			cur = _left(Nodes[cur]);
+
+		return cur;
+	}
+
+
+	/* Returns the inorder successor of cur by
+	 * following its thread, or the leftmost node
+	 * of its right subtree when not threaded */
+	INDEX _next(INDEX cur) const
+	{
+		const NODE& n = Nodes[cur];
+
+		if(_threaded(n))
+			return _right(n);
+		else
+			return _begin(_right(n));
+	}
+
+
+	/* Returns the first slot whose key is not
+	 * less than key, or 0 if there is none */
+	INDEX _lowerBound(const KeyT& key) const
+	{
+		INDEX cur = Root;    // Current Node
+		INDEX result = 0;    // Smallest key >= key seen so far
+
+		while(cur != 0)
+		{
+			const NODE& n = Nodes[cur];
+
+			if(!(n.Key < key))  // Candidate, look for a smaller one
+			{
+				result = cur;
+				cur = _left(n);
+			}
+			else
+				cur = _child(n);
+		}
+
+		return result;
+	}
+
+
+	/* Returns the first slot whose key is
+	 * greater than key, or 0 if none */
+	INDEX _upperBound(const KeyT& key) const
+	{
+		INDEX cur = Root;    // Current Node
+		INDEX result = 0;    // Smallest key > key seen so far
+
+		while(cur != 0)
+		{
+			const NODE& n = Nodes[cur];
+
+			if(key < n.Key)  // Candidate, look for a smaller one
+			{
+				result = cur;
+				cur = _left(n);
+			}
+			else
+				cur = _child(n);
+		}
+
+		return result;
+	}
+
+public:
+  //
+  // default constructor:
+  //
+  // Creates an empty tree; no memory is allocated until the first
+  // insert.
+  //
+  compact_avlt()
+    : Nodes(nullptr), Capacity(0), Used(1), FreeList(0), Root(0), Current(0), Size(0)
+  { }
+
+  //
+  // copy constructor
+  //
+  // Makes an exact copy of the "other" tree, slot for slot.
+  //
+  // Time complexity:  O(N)
+  //
+  compact_avlt(const compact_avlt& other)
+    : compact_avlt()
+  {
+    _copy(other);
+  }
+
+  //
+  // move constructor
+  //
+  // Takes over the node array of the "other" tree, which is left empty.
+  //
+  // Time complexity:  O(1)
+  //
+  compact_avlt(compact_avlt&& other) noexcept
+    : compact_avlt()
+  {
+    swap(other);
+  }
+
+  //
+  // destructor:
+  //
+  virtual ~compact_avlt()
+  {
+    clear();
+  }
+
+  //
+  // operator= / move operator=
+  //
+  // Clears "this" tree and then copies, or takes over, the "other" tree.
+  //
+  compact_avlt& operator=(const compact_avlt& other)
+  {
+    if(this == &other)  // Self assignment, nothing to do
+      return *this;
+
+    clear();
+    _copy(other);
+
+    return *this;
+  }
+
+  compact_avlt& operator=(compact_avlt&& other) noexcept
+  {
+    if(this == &other)  // Self assignment, nothing to do
+      return *this;
+
+    clear();
+    swap(other);
+
+    return *this;
+  }
+
+  //
+  // swap:
+  //
+  // Exchanges the contents of two trees.
+  //
+  // Time complexity:  O(1)
+  //
+  void swap(compact_avlt& other) noexcept
+  {
+    std::swap(Nodes, other.Nodes);
+    std::swap(Capacity, other.Capacity);
+    std::swap(Used, other.Used);
+    std::swap(FreeList, other.FreeList);
+    std::swap(Root, other.Root);
+    std::swap(Current, other.Current);
+    std::swap(Size, other.Size);
+  }
+
+  //
+  // clear:
+  //
+  // Clears the contents of the tree, resetting the tree to empty and
+  // freeing the node array.
+  //
+  void clear()
+  {
+    if constexpr (!is_trivially_destructible<NODE>::value)
+    {
+      _forEach([&](INDEX i)
+      {
+        Nodes[i].~NODE();
+      });
+    }
+
+    ::operator delete(Nodes);
+    Nodes = nullptr;
+    Capacity = 0;
+    Used = 1;
+    FreeList = 0;
+    Root = 0;
+    Current = 0;
+    Size = 0;
+  }
+
+  //
+  // reserve:
+  //
+  // Makes room for n nodes up front, so that loading n keys never
+  // grows (and moves) the node array.
+  //
+  // Time complexity:  O(N)
+  //
+  void reserve(int n)
+  {
+    if(n < 0 || (INDEX)n > MaxNodes)
+      throw length_error("compact_avlt: too many nodes");
+
+    if((INDEX)n + 1 > Capacity)
+      _resize((INDEX)n + 1);
+  }
+
+  //
+  // memory_bytes / node_bytes:
+  //
+  // Bytes held by the node array (free and unused slots included), and
+  // the size of one node.
+  //
+  size_t memory_bytes() const
+  {
+    return (size_t)Capacity * sizeof(NODE);
+  }
+
+  static constexpr size_t node_bytes()
+  {
+    return sizeof(NODE);
+  }
+
+  //
+  // size:
+  //
+  // Returns the # of nodes in the tree, 0 if empty.
+  //
+  // Time complexity:  O(1)
+  //
+  int size() const
+  {
+    return Size;
+  }
+
+  //
+  // height:
+  //
+  // Returns the height of the tree, -1 if empty.
+  //
+  // Time complexity:  O(1)
+  //
+  int height() const
+  {
+    return _heightOf(Root);
+  }
+
+  //
+  // search:
+  //
+  // Searches the tree for the given key, returning true if found
+  // and false if not.  If the key is found, the corresponding value
+  // is returned via the reference parameter.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    INDEX cur = _find(key);  // Node holding key
+
+    if(cur == 0)  // key and value pair not found
+      return false;
+
+    value = Nodes[cur].Value;
+    return true;
+  }
+
+  //
+  // range_search
+  //
+  // Returns all keys in the range [lower..upper], inclusive, in order.
+  //
+  // Time complexity: O(lgN + M), where M is the # of keys in the range
+  //
+  vector<KeyT> range_search(const KeyT& lower, const KeyT& upper) const
+  {
+    vector<KeyT> keys;
+
+    range_for_each(lower, upper, [&](const KeyT& key, const ValueT&)
+    {
+      keys.push_back(key);
+    });
+
+    return keys;
+  }
+
+  //
+  // range_for_each
+  //
+  // Same as avlt::range_for_each: calls visit(key, value) for every pair
+  // in [lower..upper], in order; a visitor returning false stops the
+  // scan.  Returns the # of pairs visited.
+  //
+  // Time complexity: O(lgN + M), where M is the # of pairs visited
+  //
+  template<typename Visitor>
+  size_t range_for_each(const KeyT& lower, const KeyT& upper, Visitor visit) const
+  {
+    size_t count = 0;
+
+    if(upper < lower)  // Invalid bounds
+      return 0;
+
+    for(INDEX cur = _lowerBound(lower); cur != 0; cur = _next(cur))
+    {
+      const NODE& n = Nodes[cur];
+
+      if(upper < n.Key)  // Past upper
+        break;
+
+      count++;
+
+      if constexpr (is_void<decltype(visit(n.Key, n.Value))>::value)
+        visit(n.Key, n.Value);
+      else if(!visit(n.Key, n.Value))
+        break;
+    }
+
+    return count;
+  }
+
+  //
+  // insert
+  //
+  // Inserts the given key into the tree; if the key has already been
+  // inserted then the function returns without changing the tree.
+  // Rotations are performed as necessary to keep the tree balanced.
+  //
+  // Time complexity:  O(lgN) worst-case, O(N) when the array grows
+  // (amortized O(lgN))
+  //
+  void insert(const KeyT& key, const ValueT& value)
+  {
+    INDEX path[MaxHeight + 1];  // Path of nodes to check heights
+    int   top = 0;
+    INDEX prev;                 // Node where we fell out of the tree
+
+    if(_searchPath(key, path, top, prev) != 0)  // Key already in tree
+      return;
+
+    /* Slots stay put if the array grows, so the path is still good */
+    INDEX i = _newNode(key, value);
+    NODE& n = Nodes[i];
+
+    if(prev == 0)
+      Root = i;
+    else if(key < Nodes[prev].Key)
+    {
+      _setLeft(Nodes[prev], i);   // Insert to the left of prev,
+      _setRight(n, prev, true);   // which is also our successor
+    }
+    else
+    {
+      _setRight(n, _right(Nodes[prev]), true);  // Inherit prev's thread
+      _setRight(Nodes[prev], i, false);
+    }
+
+    Size++;
+    _rebalance(path, top);
+  }
+
+  //
+  // erase
+  //
+  // Removes the given key (and its value) from the tree, returning true
+  // if it was found and false if not.  Same as avlt::erase.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  bool erase(const KeyT& key)
+  {
+    INDEX path[MaxHeight + 1];  // Nodes from the root down to the erased node's parent
+    int   top = 0;
+    INDEX parent;               // Parent of erased node
+
+    INDEX cur = _searchPath(key, path, top, parent);
+
+    if(cur == 0)  // Key not in tree
+      return false;
+
+    NODE& C = Nodes[cur];
+    INDEX repl;  // Node taking the erased node's place
+
+    /* Keep begin()/next() valid */
+    if(Current == cur)
+      Current = _next(cur);
+
+    if(_left(C) == 0)  // At most a right child moves up:
+    {
+      repl = _child(C);
+    }
+    else if(_threaded(C))  // Only a left child, it moves up:
+    {
+      repl = _left(C);
+
+      /* The predecessor threaded to cur, thread it past cur */
+      INDEX pred = repl;
+      while(!_threaded(Nodes[pred]))
+        pred = _right(Nodes[pred]);
+
+      _setRight(Nodes[pred], _right(C), true);
+    }
+    else  // Two children, the inorder successor moves up:
+    {
+      int slot = top++;  // Successor takes cur's place on the path
+
+      repl = _right(C);
+      while(_left(Nodes[repl]) != 0)
+      {
+        path[top++] = repl;
+        repl = _left(Nodes[repl]);
+      }
+
+      NODE& R = Nodes[repl];
+
+      /* Unlink the successor from its parent when it's deeper down */
+      if(top > slot + 1)
+      {
+        _setLeft(Nodes[path[top - 1]], _child(R));
+        _setRight(R, _right(C), false);
+      }
+
+      /* The predecessor threaded to cur, thread it to the successor */
+      INDEX pred = _left(C);
+      while(!_threaded(Nodes[pred]))
+        pred = _right(Nodes[pred]);
+
+      _setRight(Nodes[pred], repl, true);
+
+      _setLeft(R, _left(C));
+      _setHeight(R, _height(C));  // Fixed up by the rebalance below
+      path[slot] = repl;
+    }
+
+    /* Relink cur's parent to the replacement */
+    if(parent == 0)
+      Root = repl;
+    else if(_left(Nodes[parent]) == cur)
+      _setLeft(Nodes[parent], repl);
+    else if(repl == 0)  // Parent now threads to cur's successor
+      _setRight(Nodes[parent], _right(C), true);
+    else
+      _setRight(Nodes[parent], repl, false);
+
+    _freeNode(cur);
+    Size--;
+
+    _rebalance(path, top);
+
+    return true;
+  }
+
+  //
+  // []
+  //
+  // Returns the value for the given key; if the key is not found,
+  // the default value ValueT{} is returned.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  ValueT operator[](const KeyT& key) const
+  {
+    INDEX cur = _find(key);  // Node holding key
+
+    if(cur == 0)  // Key not found, return default
+      return ValueT{ };
+
+    return Nodes[cur].Value;
+  }
+
+  //
+  // ()
+  //
+  // Same as avlt: finds the key and returns the key to its "right",
+  // following the thread if there is one; KeyT{} if the key is not
+  // found or has nothing to its right.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  KeyT operator()(const KeyT& key) const
+  {
+    INDEX cur = _find(key);  // Node holding key
+
+    if(cur == 0 || _right(Nodes[cur]) == 0)  // Not found, or nothing to the right
+      return KeyT{ };
+
+    return Nodes[_right(Nodes[cur])].Key;
+  }
+
+  //
+  // %
+  //
+  // Returns the height stored in the node that contains key; if key is
+  // not found, -1 is returned.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  int operator%(const KeyT& key) const
+  {
+    INDEX cur = _find(key);  // Node holding key
+
+    if(cur == 0)  // Key not found
+      return -1;
+
+    return _height(Nodes[cur]);
+  }
+
+  //
+  // begin / next
+  //
+  // Internal-state inorder traversal, same as avlt:
+  //
+  //    tree.begin();
+  //    while (tree.next(key))
+  //      cout << key << endl;
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  void begin()
+  {
+    Current = _begin(Root);
+  }
+
+  bool next(KeyT& key)
+  {
+    if(Current == 0)  // End of the traversal
+      return false;
+
+    key = Nodes[Current].Key;
+    Current = _next(Current);
+    return true;
+  }
+
+  //
+  // const_iterator
+  //
+  // Forward iterator over the (key, value) pairs in inorder, same as
+  // avlt's.  It holds a slot number rather than a pointer, so it stays
+  // valid when the node array grows; only erasing its node or clearing
+  // the tree invalidates it.
+  //
+  class const_iterator
+  {
+  private:
+    friend class compact_avlt;
+
+    const compact_avlt* Owner;  // tree being walked
+    INDEX               Cur;    // slot at the current position, 0 at the end
+
+    const_iterator(const compact_avlt* owner, INDEX cur) : Owner(owner), Cur(cur) { }
+
+  public:
+    using iterator_category = forward_iterator_tag;
+    using value_type        = pair<KeyT, ValueT>;
+    using difference_type   = ptrdiff_t;
+    using reference         = pair<const KeyT&, const ValueT&>;
+    using pointer           = void;
+
+    const_iterator() : Owner(nullptr), Cur(0) { }
+
+    const KeyT& key() const
+    {
+      return Owner->Nodes[Cur].Key;
+    }
+
+    const ValueT& value() const
+    {
+      return Owner->Nodes[Cur].Value;
+    }
+
+    reference operator*() const
+    {
+      return reference(key(), value());
+    }
+
+    const_iterator& operator++()
+    {
+      Cur = Owner->_next(Cur);
+      return *this;
+    }
+
+    const_iterator operator++(int)
+    {
+      const_iterator old = *this;
+      Cur = Owner->_next(Cur);
+      return old;
+    }
+
+    bool operator==(const const_iterator& other) const
+    {
+      return Cur == other.Cur;
+    }
+
+    bool operator!=(const const_iterator& other) const
+    {
+      return Cur != other.Cur;
+    }
+  };
+
+  //
+  // cbegin / cend / begin / end
+  //
+  // Iterators to the first inorder pair and one past the last.
+  //
+  // Time complexity:  O(lgN) worst-case for cbegin, O(1) for cend
+  //
+  const_iterator cbegin() const
+  {
+    return const_iterator(this, _begin(Root));
+  }
+
+  const_iterator cend() const
+  {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator begin() const
+  {
+    return cbegin();
+  }
+
+  const_iterator end() const
+  {
+    return cend();
+  }
+
+  //
+  // find / lower_bound / upper_bound
+  //
+  // Same as avlt: iterator to the key, to the first key not less than
+  // it, or to the first key greater than it; cend() if there is none.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  const_iterator find(const KeyT& key) const
+  {
+    return const_iterator(this, _find(key));
+  }
+
+  const_iterator lower_bound(const KeyT& key) const
+  {
+    return const_iterator(this, _lowerBound(key));
+  }
+
+  const_iterator upper_bound(const KeyT& key) const
+  {
+    return const_iterator(this, _upperBound(key));
+  }
+
+  //
+  // dump
+  //
+  // Dumps the contents of the tree to the output stream in the same
+  // format as avlt::dump.
+  //
+  void dump(ostream& output) const
+  {
+    output << "**************************************************" << endl;
+    output << "********************* AVLT ***********************" << endl;
+
+    output << "** size: " << this->size() << endl;
+    output << "** height: " << this->height() << endl;
+
+    _print(Root, output);
+
+    output << "**************************************************" << endl;
+  }
+};
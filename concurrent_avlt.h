@@ -0,0 +1,284 @@
+/*concurrent_avlt.h*/
+
+//
+// Threaded AVL tree for many writer and reader threads: one lock per
+// key range.
+//
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sharded_avlt.h"
+
+using namespace std;
+
+//
+// concurrent_avlt
+//
+// A tree for any number of writer and reader threads.  The state is a
+// sharded_avlt: the key space is split into contiguous ranges, one avlt
+// per range, and each shard has a lock of its own.  An update locks
+// only the shard that owns its key, so writers whose keys fall in
+// different shards insert and erase at the same time, each in its own
+// tree, with its own node pool, and without copying anything.  Producers with disjoint key streams scale with the # of
+// shards they spread over; two writers only wait for each other when
+// their keys land in the same shard.  Shards have no nodes or threads
+// in common, so a shard's right threads are only ever changed under
+// its own lock, and next() and range scans inside a shard never see
+// a half-done rotation.
+//
+// Readers lock the shard too, so they only wait for threads that use
+// the same shard; a reader/writer lock would let readers of one shard
+// overlap, but costs every writer more to take than a mutex does.
+// Reads of more than one shard (range_search, size, height, snapshot)
+// lock every shard they cover, in shard order, so they see one
+// consistent state; writers only ever hold one lock, so nobody waits
+// in a cycle.
+//
+// The boundaries are picked once, from a sample of keys, when the tree
+// is made (see sharded_avlt::set_boundaries), and are fixed from then
+// on.  Several shards per core keep two writers from picking the same
+// one too often; a tree made without samples has a single shard, and
+// then writers take turns just as with one mutex around an avlt.
+//
+// NodeAlloc, OrderStats, Stats and Compare are passed on to every
+// shard; each shard's policies are only used under its lock.
+//
+// Every function is safe to call from any thread.
+//
+template<typename KeyT, typename ValueT, template<typename> class NodeAlloc = avlt_pool,
+         bool OrderStats = false, typename Stats = avlt_no_stats,
+         typename Compare = avlt_compare>
+class concurrent_avlt
+{
+public:
+  typedef sharded_avlt<KeyT, ValueT, NodeAlloc, OrderStats, Stats, Compare> tree_type;
+  typedef shared_ptr<const tree_type> snapshot_type;
+
+private:
+  // One lock per shard, each on a cache line of its own so that
+  // writers of neighboring shards don't slow each other down
+  struct alignas(64) LOCK
+  {
+    mutex Mutex;
+  };
+
+  // Holds the locks of shards First..Last until it goes away.  They
+  // are taken in shard order, so two guards never wait for each other
+  // in a cycle.
+  class GUARD
+  {
+  private:
+    LOCK* Locks;
+    int   First;
+    int   Last;
+
+  public:
+    GUARD(LOCK* locks, int first, int last)
+      : Locks(locks), First(first), Last(last)
+    {
+      for(int i = First; i <= Last; i++)
+        Locks[i].Mutex.lock();
+    }
+
+    ~GUARD()
+    {
+      for(int i = Last; i >= First; i--)
+        Locks[i].Mutex.unlock();
+    }
+
+    GUARD(const GUARD&) = delete;
+    GUARD& operator=(const GUARD&) = delete;
+  };
+
+  tree_type          Tree;   // the shards; boundaries fixed once made
+  unique_ptr<LOCK[]> Locks;  // Locks[i] guards shard i of Tree
+
+
+	/* Makes one lock per shard of Tree */
+	void _locks()
+	{
+		Locks.reset(new LOCK[Tree.shard_count()]);
+	}
+
+
+	/* Locks every shard */
+	GUARD _all() const
+	{
+		return GUARD(Locks.get(), 0, Tree.shard_count() - 1);
+	}
+
+public:
+  //
+  // constructor:
+  //
+  // Creates an empty tree with a single shard, so writers take turns;
+  // pass samples of the keys to get more.
+  //
+  explicit concurrent_avlt(const Compare& compare = Compare())
+    : Tree(compare)
+  {
+    _locks();
+  }
+
+  //
+  // sample constructor:
+  //
+  // Creates an empty tree with up to "shards" shards, whose boundaries
+  // are picked so that each one gets an equal share of the sample keys.
+  // The samples should look like the keys the writers will insert.
+  //
+  // Time complexity:  O(S lgS), S = # of samples
+  //
+  concurrent_avlt(vector<KeyT> samples, int shards = 4 * (int)thread::hardware_concurrency(),
+                  const Compare& compare = Compare())
+    : Tree(std::move(samples), shards, compare)
+  {
+    _locks();
+  }
+
+  //
+  // range constructor:
+  //
+  // Builds the tree from a range of (key, value) pairs, with up to
+  // "shards" shards split evenly over the keys in the range.
+  //
+  // Time complexity:  O(N lgN)
+  //
+  template<typename InputIt>
+  concurrent_avlt(InputIt first, InputIt last,
+                  int shards = 4 * (int)thread::hardware_concurrency(),
+                  const Compare& compare = Compare())
+    : Tree(compare)
+  {
+    vector<KeyT> samples;
+
+    for( ; first != last; ++first)
+    {
+      Tree.insert((*first).first, (*first).second);
+      samples.push_back((*first).first);
+    }
+
+    Tree.set_boundaries(std::move(samples), shards);
+    _locks();
+  }
+
+  // the locks can't be copied; take a snapshot() instead
+  concurrent_avlt(const concurrent_avlt&) = delete;
+  concurrent_avlt& operator=(const concurrent_avlt&) = delete;
+
+  //
+  // shard_count:
+  //
+  // The # of shards, each with its own lock.
+  //
+  int shard_count() const
+  {
+    return Tree.shard_count();
+  }
+
+  //
+  // snapshot:
+  //
+  // Returns a copy of the whole tree as it was at one moment.  The copy
+  // is the caller's own and never changes; use it to run many reads
+  // against one consistent state without holding up writers.  Writers
+  // wait while the copy is being made.
+  //
+  // Time complexity:  O(N)
+  //
+  snapshot_type snapshot() const
+  {
+    GUARD guard = _all();
+    return make_shared<const tree_type>(Tree);
+  }
+
+  //
+  // insert / erase:
+  //
+  // Writer functions; see avlt.  Each one locks the shard that owns the
+  // key, and readers see the update as soon as it returns.
+  //
+  // Time complexity:  O(lg(# of shards) + lg(shard size))
+  //
+  void insert(const KeyT& key, const ValueT& value)
+  {
+    int   i = Tree.shard_of(key);
+    GUARD guard(Locks.get(), i, i);
+
+    Tree.shard(i).insert(key, value);
+  }
+
+  bool erase(const KeyT& key)
+  {
+    int   i = Tree.shard_of(key);
+    GUARD guard(Locks.get(), i, i);
+
+    return Tree.shard(i).erase(key);
+  }
+
+  //
+  // clear:
+  //
+  // Empties every shard, keeping the boundaries.
+  //
+  // Time complexity:  O(N)
+  //
+  void clear()
+  {
+    GUARD guard = _all();
+    Tree.clear();
+  }
+
+  //
+  // search / operator[]:
+  //
+  // Reader functions; see avlt.  Each one locks the shard that owns the
+  // key.
+  //
+  // Time complexity:  O(lg(# of shards) + lg(shard size))
+  //
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    int   i = Tree.shard_of(key);
+    GUARD guard(Locks.get(), i, i);
+
+    return Tree.shard(i).search(key, value);
+  }
+
+  ValueT operator[](const KeyT& key) const
+  {
+    int   i = Tree.shard_of(key);
+    GUARD guard(Locks.get(), i, i);
+
+    return Tree.shard(i)[key];
+  }
+
+  //
+  // range_search / size / height:
+  //
+  // Reader functions; see sharded_avlt.  Each one locks every shard it
+  // reads, so the result matches one state of the tree.
+  //
+  vector<KeyT> range_search(const KeyT& lower, const KeyT& upper) const
+  {
+    GUARD guard(Locks.get(), Tree.shard_of(lower), Tree.shard_of(upper));
+    return Tree.range_search(lower, upper);
+  }
+
+  int size() const
+  {
+    GUARD guard = _all();
+    return Tree.size();
+  }
+
+  int height() const
+  {
+    GUARD guard = _all();
+    return Tree.height();
+  }
+};
@@ -0,0 +1,580 @@
+/*durable_avlt.h*/
+
+//
+// Crash-safe threaded AVL tree: write-ahead journal plus checkpoints.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "avlt.h"
+
+using namespace std;
+
+//
+// durable_avlt
+//
+// Wraps an avlt so its contents survive a crash.  The tree itself
+// stays in memory; every update that changes it is also appended to a
+// journal file, and now and then the whole tree is written out as a
+// checkpoint (an avlt::save() image), after which the journal starts
+// over.  Opening the directory again loads the last checkpoint and
+// replays the journal written since, stopping at the first record that
+// is incomplete or fails its checksum, i.e. wherever a crash cut the
+// last write short.
+//
+// Files in the directory:
+//
+//    checkpoint   tree image, replaced atomically by rename()
+//    journal      records: [ length | checksum | op | key | value ]
+//
+// Journal writes are batched.  Updates are encoded into an in-memory
+// buffer under the tree lock; one thread at a time writes the buffer
+// out and fsyncs it with the lock released, and every update that made
+// it into that buffer is durable once the fsync returns.  With
+// syncEvery == 1, insert() and erase() wait until their own record is
+// durable, and updates from other threads that arrive meanwhile share
+// the next fsync (group commit).  With syncEvery > 1 they return once
+// the record is buffered, and the buffer is synced every syncEvery
+// updates or on sync(); a crash can then lose up to the last
+// syncEvery - 1 updates, but never leaves the tree half-updated.
+//
+// A checkpoint is taken by checkpoint(), or automatically once the
+// journal grows past checkpointBytes.  If an automatic checkpoint
+// fails, e.g. on a full disk, the update that triggered it is journaled
+// and synced as usual, and the next attempt waits until the journal has
+// grown by another checkpointBytes; checkpoint() reports the error.  If a crash hits after the new
+// checkpoint is in place but before the journal is emptied, recovery
+// replays the journal over a tree that already holds those updates;
+// that changes nothing, because only updates that changed the tree are
+// logged: an insert of a new key and an erase of a present key.
+//
+// Keys and values are written with the codecs given, as for
+// avlt::save().  Stats and Compare are the avlt policies of the tree
+// in memory; reopen a directory with the same Compare it was written
+// with.  Every function is safe to call from any thread.
+//
+template<typename KeyT, typename ValueT, typename KeyCodec = avlt_codec<KeyT>,
+         typename ValueCodec = avlt_codec<ValueT>, typename Stats = avlt_no_stats,
+         typename Compare = avlt_compare>
+class durable_avlt
+{
+public:
+  typedef avlt<KeyT, ValueT, avlt_pool, false, Stats, Compare> tree_type;
+
+private:
+  // Journal record operations
+  static const char OpInsert = 'I';
+  static const char OpErase  = 'E';
+  static const char OpClear  = 'C';
+
+  // Bytes of a record header: payload length and checksum
+  static const size_t HeaderBytes = 2 * sizeof(uint32_t);
+
+  /* Output stream buffer that appends to a string */
+  struct APPENDBUF : streambuf
+  {
+    string* Out;
+
+    int_type overflow(int_type c) override
+    {
+      if(c != traits_type::eof())
+        Out->push_back((char)c);
+
+      return c;
+    }
+
+    streamsize xsputn(const char* s, streamsize n) override
+    {
+      Out->append(s, (size_t)n);
+      return n;
+    }
+  };
+
+  /* Input stream buffer over a range of memory */
+  struct SPANBUF : streambuf
+  {
+    SPANBUF(char* first, char* last)
+    {
+      setg(first, first, last);
+    }
+  };
+
+  tree_type Tree;             // the tree, only touched under Lock
+  string    Dir;              // directory holding the files
+  int       Journal;          // journal file descriptor
+  int       SyncEvery;        // # of updates per fsync
+  size_t    CheckpointBytes;  // journal size that triggers a checkpoint
+  size_t    CheckpointAt;     // journal size of the next automatic checkpoint
+
+  mutable mutex      Lock;    // guards everything below and Tree
+  condition_variable Synced;  // signaled when a flush finishes
+  string    Buffer;           // encoded records not yet written
+  APPENDBUF Sink;             // appends to Buffer
+  ostream   Encoder;          // writes through Sink
+  uint64_t  Logged;           // # of records encoded so far
+  uint64_t  Durable;          // # of records written and synced
+  size_t    JournalBytes;     // bytes in the journal file, written or not
+  bool      Flushing;         // true => some thread is writing the journal
+  bool      Broken;           // true => a journal write failed
+
+
+	/* FNV-1a checksum of a record's payload */
+	static uint32_t _checksum(const char* p, size_t n)
+	{
+		uint32_t h = 2166136261u;
+
+		for(size_t i = 0; i < n; i++)
+		{
+			h ^= (unsigned char)p[i];
+			h *= 16777619u;
+		}
+
+		return h;
+	}
+
+
+	/* Writes all n bytes at p to fd */
+	static bool _writeAll(int fd, const char* p, size_t n)
+	{
+		while(n > 0)
+		{
+			ssize_t w = ::write(fd, p, n);
+
+			if(w < 0 && errno == EINTR)
+				continue;
+
+			if(w <= 0)
+				return false;
+
+			p += w;
+			n -= (size_t)w;
+		}
+
+		return true;
+	}
+
+
+	/* Flushes a file's data to the disk */
+	static bool _sync(int fd)
+	{
+#if defined(__linux__)
+		return fdatasync(fd) == 0;
+#else
+		return fsync(fd) == 0;
+#endif
+	}
+
+
+	/* Opens path and flushes it to the disk; used on
+	 * the directory itself so renames and new files
+	 * are durable too */
+	static void _syncPath(const string& path)
+	{
+		int fd = open(path.c_str(), O_RDONLY);
+
+		if(fd < 0 || fsync(fd) != 0)
+		{
+			if(fd >= 0)
+				close(fd);
+
+			throw runtime_error("durable_avlt: cannot sync " + path);
+		}
+
+		close(fd);
+	}
+
+
+	/* Encodes one record at the end of Buffer; Lock
+	 * must be held.  value is ignored unless op is
+	 * an insert. */
+	void _log(char op, const KeyT* key, const ValueT* value)
+	{
+		size_t start = Buffer.size();
+		Buffer.append(HeaderBytes, '\0');  // Filled in below
+
+		Encoder.put(op);
+		if(key != nullptr)
+			KeyCodec::write(Encoder, *key);
+		if(value != nullptr)
+			ValueCodec::write(Encoder, *value);
+
+		uint32_t length = (uint32_t)(Buffer.size() - start - HeaderBytes);
+		uint32_t checksum = _checksum(&Buffer[start + HeaderBytes], length);
+
+		memcpy(&Buffer[start], &length, sizeof(length));
+		memcpy(&Buffer[start + sizeof(length)], &checksum, sizeof(checksum));
+
+		Logged++;
+		JournalBytes += HeaderBytes + length;
+	}
+
+
+	/* Waits until every record up to # upto is durable,
+	 * writing and syncing the buffer itself if no other
+	 * thread is doing so; lock holds Lock */
+	void _flush(unique_lock<mutex>& lock, uint64_t upto)
+	{
+		while(Durable < upto)
+		{
+			if(Broken)
+				throw runtime_error("durable_avlt: journal write failed in " + Dir);
+
+			if(Flushing)  // Ride along on the flush in progress
+			{
+				Synced.wait(lock);
+				continue;
+			}
+
+			/* Become the flusher: take the whole buffer,
+			 * including records queued after ours */
+			string   batch;
+			uint64_t end = Logged;
+
+			batch.swap(Buffer);
+			Flushing = true;
+
+			lock.unlock();
+			bool ok = _writeAll(Journal, batch.data(), batch.size()) && _sync(Journal);
+			lock.lock();
+
+			Flushing = false;
+			if(ok)
+				Durable = end;
+			else
+				Broken = true;
+
+			Synced.notify_all();
+		}
+
+		if(Broken && Durable < upto)
+			throw runtime_error("durable_avlt: journal write failed in " + Dir);
+	}
+
+
+	/* Finishes an update that logged one record; lock
+	 * holds Lock.  A failed checkpoint leaves the record
+	 * in the journal, which is flushed as if there had
+	 * been no checkpoint, and is not tried again until
+	 * another CheckpointBytes have been logged. */
+	void _commit(unique_lock<mutex>& lock)
+	{
+		if(JournalBytes >= CheckpointAt)
+		{
+			CheckpointAt = JournalBytes + CheckpointBytes;
+
+			try
+			{
+				_checkpoint(lock);  // Also makes everything durable
+				return;
+			}
+			catch(const exception&)  // The journal still holds every update
+			{
+			}
+		}
+
+		if(SyncEvery <= 1 || Logged - Durable >= (uint64_t)SyncEvery)
+			_flush(lock, Logged);
+	}
+
+
+	/* Saves the tree as the new checkpoint and empties
+	 * the journal; lock holds Lock.  Buffered records
+	 * are dropped: the checkpoint holds their updates. */
+	void _checkpoint(unique_lock<mutex>& lock)
+	{
+		while(Flushing)  // Let the flush in progress finish
+			Synced.wait(lock);
+
+		if(Broken)
+			throw runtime_error("durable_avlt: journal write failed in " + Dir);
+
+		string next = Dir + "/checkpoint.new";
+		string path = Dir + "/checkpoint";
+
+		Tree.template save<KeyCodec, ValueCodec>(next);
+		_syncPath(next);
+
+		if(rename(next.c_str(), path.c_str()) != 0)
+			throw runtime_error("durable_avlt: cannot rename " + next + " to " + path);
+
+		_syncPath(Dir);
+
+		/* The checkpoint holds every update, start the journal over */
+		if(ftruncate(Journal, 0) != 0 || fsync(Journal) != 0)
+		{
+			Broken = true;
+			throw runtime_error("durable_avlt: cannot truncate the journal in " + Dir);
+		}
+
+		Buffer.clear();
+		Durable = Logged;
+		JournalBytes = 0;
+		CheckpointAt = CheckpointBytes;
+
+		Synced.notify_all();
+	}
+
+
+	/* Replays the journal into the tree, then cuts off
+	 * a torn record at its end, if any */
+	void _recover()
+	{
+		string path = Dir + "/journal";
+		FILE*  in = fopen(path.c_str(), "rb");
+
+		if(in == nullptr)  // No journal yet
+			return;
+
+		struct stat st;
+		fstat(fileno(in), &st);
+
+		vector<char> payload;
+		size_t       good = 0;  // bytes of whole, valid records
+
+		while(true)
+		{
+			uint32_t header[2];  // length, checksum
+
+			if(fread(header, 1, HeaderBytes, in) != HeaderBytes)
+				break;
+
+			if(header[0] == 0 || good + HeaderBytes + header[0] > (size_t)st.st_size)
+				break;  // Cut short
+
+			payload.resize(header[0]);
+
+			if(fread(payload.data(), 1, header[0], in) != header[0] ||
+			   _checksum(payload.data(), header[0]) != header[1])
+				break;  // Torn or corrupt, everything after it is lost
+
+			SPANBUF span(payload.data(), payload.data() + payload.size());
+			istream record(&span);
+			char    op = (char)record.get();
+			KeyT    key;
+			ValueT  value;
+
+			if(op == OpInsert)
+			{
+				KeyCodec::read(record, key);
+				ValueCodec::read(record, value);
+			}
+			else if(op == OpErase)
+				KeyCodec::read(record, key);
+			else if(op != OpClear)
+				break;
+
+			if(!record)
+				break;
+
+			if(op == OpInsert)
+				Tree.insert(std::move(key), std::move(value));
+			else if(op == OpErase)
+				Tree.erase(key);
+			else
+				Tree.clear();
+
+			good += HeaderBytes + header[0];
+		}
+
+		fclose(in);
+
+		if(truncate(path.c_str(), (off_t)good) != 0)
+			throw runtime_error("durable_avlt: cannot truncate " + path);
+
+		JournalBytes = good;
+	}
+
+public:
+  //
+  // constructor:
+  //
+  // Opens the tree stored in directory dir, creating the directory if
+  // it does not exist, and recovers its contents from the checkpoint
+  // and journal there.  syncEvery is the # of updates per fsync (1 =>
+  // every update is durable when it returns); a checkpoint is taken
+  // whenever the journal reaches checkpointBytes.  compare orders the
+  // tree.  Throws runtime_error if the files cannot be read or written.
+  //
+  // Time complexity:  O(N + J), J the # of journal records
+  //
+  durable_avlt(const string& dir, int syncEvery = 1, size_t checkpointBytes = (size_t)64 << 20,
+               const Compare& compare = Compare())
+    : Tree(compare), Dir(dir), Journal(-1), SyncEvery(syncEvery), CheckpointBytes(checkpointBytes),
+      CheckpointAt(checkpointBytes), Encoder(&Sink), Logged(0), Durable(0), JournalBytes(0),
+      Flushing(false), Broken(false)
+  {
+    Sink.Out = &Buffer;
+
+    if(mkdir(Dir.c_str(), 0777) != 0 && errno != EEXIST)
+      throw runtime_error("durable_avlt: cannot create " + Dir);
+
+    string checkpoint = Dir + "/checkpoint";
+    if(access(checkpoint.c_str(), F_OK) == 0)
+      Tree.template load<KeyCodec, ValueCodec>(checkpoint);
+
+    _recover();
+
+    string journal = Dir + "/journal";
+    Journal = open(journal.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666);
+    if(Journal < 0)
+      throw runtime_error("durable_avlt: cannot open " + journal);
+
+    try
+    {
+      _syncPath(Dir);
+    }
+    catch(...)
+    {
+      close(Journal);
+      throw;
+    }
+  }
+
+  durable_avlt(const durable_avlt&) = delete;
+  durable_avlt& operator=(const durable_avlt&) = delete;
+
+  //
+  // destructor:
+  //
+  // Syncs any buffered updates, then closes the journal.
+  //
+  ~durable_avlt()
+  {
+    try
+    {
+      sync();
+    }
+    catch(...)  // Nothing to report to, the updates stay lost
+    {
+    }
+
+    close(Journal);
+  }
+
+  //
+  // insert / erase / clear:
+  //
+  // Same as avlt, plus journaling.  With syncEvery == 1 each returns
+  // once the update is durable; otherwise once it is buffered.  An
+  // update that does not change the tree is not logged.  Throws
+  // runtime_error if the journal cannot be written; the update is then
+  // applied in memory but may not survive a crash.
+  //
+  // Time complexity:  O(lgN), plus a share of an fsync
+  //
+  void insert(const KeyT& key, const ValueT& value)
+  {
+    unique_lock<mutex> lock(Lock);
+
+    if(!Tree.try_emplace(key, value))  // Already there, nothing to log
+      return;
+
+    _log(OpInsert, &key, &value);
+    _commit(lock);
+  }
+
+  bool erase(const KeyT& key)
+  {
+    unique_lock<mutex> lock(Lock);
+
+    if(!Tree.erase(key))
+      return false;
+
+    _log(OpErase, &key, nullptr);
+    _commit(lock);
+
+    return true;
+  }
+
+  void clear()
+  {
+    unique_lock<mutex> lock(Lock);
+
+    Tree.clear();
+    _log(OpClear, nullptr, nullptr);
+    _commit(lock);
+  }
+
+  //
+  // sync:
+  //
+  // Makes every update that has returned so far durable.
+  //
+  // Time complexity:  O(1), plus an fsync
+  //
+  void sync()
+  {
+    unique_lock<mutex> lock(Lock);
+    _flush(lock, Logged);
+  }
+
+  //
+  // checkpoint:
+  //
+  // Writes the whole tree as the new checkpoint and empties the
+  // journal, so the next recovery has nothing to replay.  Updates wait
+  // while the checkpoint is written.
+  //
+  // Time complexity:  O(N)
+  //
+  void checkpoint()
+  {
+    unique_lock<mutex> lock(Lock);
+    _checkpoint(lock);
+  }
+
+  //
+  // search / operator[] / range_search / size:
+  //
+  // Same as avlt, against the in-memory tree.
+  //
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    lock_guard<mutex> guard(Lock);
+    return Tree.search(key, value);
+  }
+
+  ValueT operator[](const KeyT& key) const
+  {
+    lock_guard<mutex> guard(Lock);
+    return Tree[key];
+  }
+
+  vector<KeyT> range_search(const KeyT& lower, const KeyT& upper) const
+  {
+    lock_guard<mutex> guard(Lock);
+    return Tree.range_search(lower, upper);
+  }
+
+  int size() const
+  {
+    lock_guard<mutex> guard(Lock);
+    return Tree.size();
+  }
+
+  //
+  // tree:
+  //
+  // The in-memory tree.  Only safe to use while no other thread is
+  // updating it.
+  //
+  const tree_type& tree() const
+  {
+    return Tree;
+  }
+};
@@ -0,0 +1,410 @@
+/*frozen_avlt.h*/
+
+//
+// Immutable, read-optimized copy of an avlt in Eytzinger (BFS) order.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "avlt.h"
+#include "frozen_simd.h"
+
+using namespace std;
+
+//
+// frozen_avlt
+//
+// A flat copy of a tree's (key, value) pairs for read-only phases,
+// made with avlt::freeze().  The keys are stored in Eytzinger order:
+// slot 1 holds the root of a perfectly balanced tree over the sorted
+// keys and the children of slot k are in slots 2k and 2k+1, so the
+// tree is implicit, there are no links to chase, and the first levels
+// of every search share the same few cache lines.  Values live in a
+// separate array in the same order, so a search only touches keys.
+//
+// Each search level is one compare whose result is added into the
+// next slot number (k = 2k + (key at k < key)), with no branch that
+// depends on the keys, and the key block a few levels below is
+// prefetched while the current level is compared.  Where the key
+// would be is read off the final slot number once the descent runs
+// off the bottom.  For int and long long keys under the default
+// Compare, in trees small enough for it to pay off, four levels are
+// taken per step with vector compares instead; see frozen_simd.h.
+//
+// Compare orders the keys as in avlt, and freeze() passes on the
+// tree's own.
+//
+// A frozen_avlt never changes, so any number of threads may read it.
+//
+template<typename KeyT, typename ValueT, typename Compare = avlt_compare>
+class frozen_avlt : private Compare
+{
+private:
+  vector<KeyT>   Keys;    // Keys[k], k = 1..Size, in Eytzinger order
+  vector<ValueT> Values;  // value of Keys[k]
+  size_t         Size;    // # of pairs
+
+  // Keys per 64-byte cache line, so the prefetch four levels down
+  // lands on the first of the 16 slots there
+  static const size_t LineKeys = (sizeof(KeyT) >= 64) ? 1 : 64 / sizeof(KeyT);
+
+  // The vector compares are the default order's
+  static const bool Simd = frozen_simd<KeyT>::enabled && is_same<Compare, avlt_compare>::value;
+
+
+	/* true if a comes before b under Compare */
+	bool _less(const KeyT& a, const KeyT& b) const
+	{
+		return avlt_less(static_cast<const Compare&>(*this), a, b);
+	}
+
+
+	/* Fills slot k and its subtree from the sorted
+	 * pairs at it; an inorder walk of the implicit
+	 * tree visits the slots in key order */
+	template<typename InputIt>
+	void _fill(InputIt& it, size_t k)
+	{
+		if(k > Size)
+			return;
+
+		_fill(it, 2 * k);  // Smaller keys first
+
+		Keys[k] = (*it).first;
+		Values[k] = (*it).second;
+		++it;
+
+		_fill(it, 2 * k + 1);
+	}
+
+
+	/* Undoes the descent: strips the trailing right
+	 * turns (1 bits) plus the left turn above them,
+	 * which gives the last slot where we went left,
+	 * i.e. the answer; 0 if we never went left */
+	static size_t _unwind(size_t k)
+	{
+#if defined(__GNUC__)
+		return k >> (__builtin_ctzll(~(unsigned long long)k) + 1);
+#else
+		while(k & 1)
+			k >>= 1;
+
+		return k >> 1;
+#endif
+	}
+
+
+	/* Prefetches the keys a few levels
+	 * below slot k, if there are any */
+	void _prefetch(size_t k) const
+	{
+#if defined(__GNUC__)
+		if(k * LineKeys <= Size)
+			__builtin_prefetch(&Keys[k * LineKeys]);
+#else
+		(void)k;
+#endif
+	}
+
+
+	/* Returns the slot of the first key not less than
+	 * key (upper => greater than key), 0 if none */
+	size_t _bound(const KeyT& key, bool upper) const
+	{
+		if constexpr (Simd)  // Block search, where it is faster
+		{
+			if(Size <= frozen_simd<KeyT>::max_keys)
+				return frozen_simd<KeyT>::bound(Keys.data(), Size, key, upper);
+		}
+
+		size_t k = 1;  // Current slot
+
+		while(k <= Size)
+		{
+			_prefetch(k);
+
+			bool right = upper ? !_less(key, Keys[k]) : _less(Keys[k], key);
+			k = 2 * k + right;  // No branch on the compare
+		}
+
+		return _unwind(k);
+	}
+
+
+	/* Returns the slot of the inorder successor
+	 * of slot k, 0 after the last one */
+	size_t _next(size_t k) const
+	{
+		if(2 * k + 1 <= Size)  // Leftmost slot of the right subtree
+		{
+			k = 2 * k + 1;
+			while(2 * k <= Size)
+				k = 2 * k;
+
+			return k;
+		}
+
+		/* Climb past every right turn, then one left turn */
+		while(k & 1)
+			k >>= 1;
+
+		return k >> 1;
+	}
+
+public:
+  //
+  // constructor:
+  //
+  // Builds the frozen copy from n (key, value) pairs in ascending key
+  // order under compare, such as an avlt's const iterators;
+  // avlt::freeze() does this.  One pass over the input, no sorting.
+  //
+  // Time complexity:  O(N)
+  //
+  template<typename InputIt>
+  frozen_avlt(InputIt first, size_t n, const Compare& compare = Compare())
+    : Compare(compare), Keys(n + 1), Values(n + 1), Size(n)
+  {
+    _fill(first, 1);
+  }
+
+  //
+  // default constructor:
+  //
+  // An empty frozen tree.
+  //
+  explicit frozen_avlt(const Compare& compare = Compare())
+    : Compare(compare), Keys(1), Values(1), Size(0)
+  { }
+
+  //
+  // size:
+  //
+  // Returns the # of pairs.
+  //
+  // Time complexity:  O(1)
+  //
+  int size() const
+  {
+    return (int)Size;
+  }
+
+  //
+  // search:
+  //
+  // Same as avlt::search: true and the value if key is present, false
+  // if not.
+  //
+  // Time complexity:  O(lgN), one branch-free compare per level
+  //
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    size_t k = _bound(key, false);
+
+    if(k == 0 || _less(key, Keys[k]))  // Not found
+      return false;
+
+    value = Values[k];
+    return true;
+  }
+
+  //
+  // []
+  //
+  // Returns the value for the given key, or ValueT{} if not found.
+  //
+  // Time complexity:  O(lgN)
+  //
+  ValueT operator[](const KeyT& key) const
+  {
+    size_t k = _bound(key, false);
+
+    if(k == 0 || _less(key, Keys[k]))  // Not found
+      return ValueT{ };
+
+    return Values[k];
+  }
+
+  //
+  // const_iterator
+  //
+  // Forward iterator over the (key, value) pairs in key order; the
+  // same interface as avlt::const_iterator.
+  //
+  class const_iterator
+  {
+  private:
+    friend class frozen_avlt;
+
+    const frozen_avlt* Owner;  // tree being walked
+    size_t             Slot;   // slot at the current position, 0 at the end
+
+    const_iterator(const frozen_avlt* owner, size_t slot) : Owner(owner), Slot(slot) { }
+
+  public:
+    using iterator_category = forward_iterator_tag;
+    using value_type        = pair<KeyT, ValueT>;
+    using difference_type   = ptrdiff_t;
+    using reference         = pair<const KeyT&, const ValueT&>;
+    using pointer           = void;
+
+    const_iterator() : Owner(nullptr), Slot(0) { }
+
+    const KeyT& key() const
+    {
+      return Owner->Keys[Slot];
+    }
+
+    const ValueT& value() const
+    {
+      return Owner->Values[Slot];
+    }
+
+    reference operator*() const
+    {
+      return reference(key(), value());
+    }
+
+    const_iterator& operator++()
+    {
+      Slot = Owner->_next(Slot);
+      return *this;
+    }
+
+    const_iterator operator++(int)
+    {
+      const_iterator old = *this;
+      Slot = Owner->_next(Slot);
+      return old;
+    }
+
+    bool operator==(const const_iterator& other) const
+    {
+      return Slot == other.Slot;
+    }
+
+    bool operator!=(const const_iterator& other) const
+    {
+      return Slot != other.Slot;
+    }
+  };
+
+  //
+  // cbegin / cend / begin / end:
+  //
+  // Iterators to the smallest pair and one past the largest.  In-order
+  // scans step through the implicit tree, O(1) amortized per pair.
+  //
+  // Time complexity:  O(lgN) for cbegin, O(1) for cend
+  //
+  const_iterator cbegin() const
+  {
+    size_t k = (Size == 0) ? 0 : 1;
+
+    while(k != 0 && 2 * k <= Size)  // Leftmost slot
+      k = 2 * k;
+
+    return const_iterator(this, k);
+  }
+
+  const_iterator cend() const
+  {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator begin() const
+  {
+    return cbegin();
+  }
+
+  const_iterator end() const
+  {
+    return cend();
+  }
+
+  //
+  // find / lower_bound / upper_bound
+  //
+  // Same as avlt: iterator to the key, to the first key not less than
+  // it, or to the first key greater than it; cend() if there is none.
+  //
+  // Time complexity:  O(lgN), one branch-free compare per level
+  //
+  const_iterator find(const KeyT& key) const
+  {
+    size_t k = _bound(key, false);
+
+    if(k != 0 && _less(key, Keys[k]))  // Not found
+      k = 0;
+
+    return const_iterator(this, k);
+  }
+
+  const_iterator lower_bound(const KeyT& key) const
+  {
+    return const_iterator(this, _bound(key, false));
+  }
+
+  const_iterator upper_bound(const KeyT& key) const
+  {
+    return const_iterator(this, _bound(key, true));
+  }
+
+  //
+  // range_for_each
+  //
+  // Same as avlt::range_for_each: calls visit(key, value) for every pair
+  // in [lower..upper], in order; a visitor returning false stops the
+  // scan.  Returns the # of pairs visited.
+  //
+  // Time complexity:  O(lgN + M), where M is the # of pairs visited
+  //
+  template<typename Visitor>
+  size_t range_for_each(const KeyT& lower, const KeyT& upper, Visitor visit) const
+  {
+    size_t count = 0;
+
+    if(_less(upper, lower))  // Invalid bounds
+      return 0;
+
+    for(size_t k = _bound(lower, false); k != 0 && !_less(upper, Keys[k]); k = _next(k))
+    {
+      count++;
+
+      if constexpr (is_void<decltype(visit(Keys[k], Values[k]))>::value)
+        visit(Keys[k], Values[k]);
+      else if(!visit(Keys[k], Values[k]))
+        break;
+    }
+
+    return count;
+  }
+
+  //
+  // range_search
+  //
+  // Same as avlt::range_search: every key in [lower..upper], inclusive,
+  // in order.
+  //
+  // Time complexity:  O(lgN + M)
+  //
+  vector<KeyT> range_search(const KeyT& lower, const KeyT& upper) const
+  {
+    vector<KeyT> keys;
+
+    range_for_each(lower, upper, [&](const KeyT& key, const ValueT&)
+    {
+      keys.push_back(key);
+    });
+
+    return keys;
+  }
+};
@@ -0,0 +1,314 @@
+/*frozen_simd.h*/
+
+//
+// SIMD block search for frozen_avlt with int and long long keys.
+//
+
+#pragma once
+
+#include <cstddef>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FROZEN_SIMD_X86 1
+#endif
+
+using namespace std;
+
+//
+// frozen_simd
+//
+// frozen_avlt keeps its keys in Eytzinger order: the children of slot
+// k are 2k and 2k+1.  The 15 slots of the four levels below and at k
+// are then four contiguous runs, k, 2k..2k+1, 4k..4k+3 and 8k..8k+7,
+// and they form a complete binary search tree.  The # of those keys
+// less than the search key (its rank among them) is exactly the four
+// left/right turns of the descent read as a binary number, so the
+// search can jump from k to slot 16k + rank in one step.
+//
+// The rank is computed with vector compares over the 8k and 4k runs,
+// plus the three remaining keys; all four loads are independent, so a
+// step costs one round of cache misses instead of four dependent ones.
+// The last, incomplete levels are walked one at a time as before.
+//
+// The block search only wins while the keys mostly stay in cache.  Once
+// every step misses to memory, the scalar search, which prefetches four
+// levels ahead, keeps more loads in flight.  Measured with
+// bench/simd_bench, the block search was 2-3x faster at 64K keys, up to
+// 1.6x faster at 1M, even with the scalar search at 4M ints (16 MB),
+// and 40-55% slower at 8M keys and beyond.  So frozen_avlt only uses it
+// for up to max_keys keys, 16 MB of them.
+//
+// Only int and long long keys are specialized; for any other KeyT,
+// enabled is false and frozen_avlt uses its scalar search unchanged.
+// The instruction set is picked at run time: AVX2 where the CPU has
+// it, then SSE2 (int) or SSE4.2 (long long), then plain C++ that
+// computes the same rank without vector instructions.
+//
+template<typename KeyT>
+struct frozen_simd
+{
+  static const bool enabled = false;
+};
+
+//
+// frozen_simd_base
+//
+// The parts shared by the int and long long versions.
+//
+template<typename KeyT>
+struct frozen_simd_base
+{
+  static const bool enabled = true;
+
+  // Largest tree the block search is used for
+  static const size_t max_keys = ((size_t)16 << 20) / sizeof(KeyT);
+
+  // bound(keys, size, key, upper): slot of the first key not less than
+  // key (upper => greater than key), 0 if none; keys[1..size]
+  typedef size_t (*BOUND)(const KeyT* keys, size_t size, KeyT key, bool upper);
+
+  /* Undoes the descent, see frozen_avlt::_unwind */
+  static size_t _unwind(size_t k)
+  {
+#if defined(__GNUC__)
+    return k >> (__builtin_ctzll(~(unsigned long long)k) + 1);
+#else
+    while(k & 1)
+      k >>= 1;
+
+    return k >> 1;
+#endif
+  }
+
+  /* # of keys in keys[first, first+count) that are less than
+   * key, or not greater than key when upper */
+  static int _rankRun(const KeyT* keys, size_t first, size_t count, KeyT key, bool upper)
+  {
+    int r = 0;
+
+    for(size_t i = first; i < first + count; i++)
+      r += upper ? !(key < keys[i]) : (keys[i] < key);
+
+    return r;
+  }
+
+  /* Prefetches the first two rows of the next step's block,
+   * 16k..16k+15 and 32k..32k+31, which hold the next slot and
+   * its children whatever the rank turns out to be */
+  static void _prefetchNext(const KeyT* keys, size_t size, size_t k)
+  {
+#if defined(__GNUC__)
+    const size_t lineKeys = 64 / sizeof(KeyT);
+
+    for(size_t row = 16; row <= 32; row *= 2)  // Rows of 16 and 32 keys
+    {
+      for(size_t i = row * k; i < row * k + row && i <= size; i += lineKeys)
+        __builtin_prefetch(keys + i);
+    }
+#else
+    (void)keys; (void)size; (void)k;
+#endif
+  }
+
+  /* Finishes a descent one level at a time */
+  static size_t _finish(const KeyT* keys, size_t size, size_t k, KeyT key, bool upper)
+  {
+    while(k <= size)
+      k = 2 * k + (upper ? !(key < keys[k]) : (keys[k] < key));
+
+    return _unwind(k);
+  }
+
+  /* Plain C++ fallback: four levels per step, no vector code */
+  static size_t _boundScalar(const KeyT* keys, size_t size, KeyT key, bool upper)
+  {
+    size_t k = 1;
+
+    while(8 * k + 7 <= size)  // All four levels below k exist
+    {
+      _prefetchNext(keys, size, k);
+
+      int r = _rankRun(keys, k, 1, key, upper) + _rankRun(keys, 2 * k, 2, key, upper) +
+              _rankRun(keys, 4 * k, 4, key, upper) + _rankRun(keys, 8 * k, 8, key, upper);
+
+      k = 16 * k + r;
+    }
+
+    return _finish(keys, size, k, key, upper);
+  }
+
+  /* Picks the best version the CPU supports, once */
+  static size_t bound(const KeyT* keys, size_t size, KeyT key, bool upper)
+  {
+    static const BOUND best = frozen_simd<KeyT>::_pick();
+
+    return best(keys, size, key, upper);
+  }
+};
+
+template<>
+struct frozen_simd<int> : frozen_simd_base<int>
+{
+#if defined(FROZEN_SIMD_X86)
+  /* Count of lanes set in a compare mask */
+  static int _lanes128(__m128i m)
+  {
+    return __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(m)));
+  }
+
+  /* SSE2, part of every x86-64 CPU */
+  static size_t _boundSse2(const int* keys, size_t size, int key, bool upper)
+  {
+    __m128i x = _mm_set1_epi32(key);
+    size_t  k = 1;
+
+    while(8 * k + 7 <= size)
+    {
+      _prefetchNext(keys, size, k);
+
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + 8 * k));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + 8 * k + 4));
+      __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + 4 * k));
+
+      int r = _rankRun(keys, k, 1, key, upper) + _rankRun(keys, 2 * k, 2, key, upper);
+
+      if(upper)  // Count keys <= key as all minus keys > key
+        r += 12 - _lanes128(_mm_cmpgt_epi32(a, x)) - _lanes128(_mm_cmpgt_epi32(b, x))
+                - _lanes128(_mm_cmpgt_epi32(c, x));
+      else
+        r += _lanes128(_mm_cmpgt_epi32(x, a)) + _lanes128(_mm_cmpgt_epi32(x, b))
+           + _lanes128(_mm_cmpgt_epi32(x, c));
+
+      k = 16 * k + r;
+    }
+
+    return _finish(keys, size, k, key, upper);
+  }
+
+  __attribute__((target("avx2")))
+  static size_t _boundAvx2(const int* keys, size_t size, int key, bool upper)
+  {
+    __m256i x8 = _mm256_set1_epi32(key);
+    __m128i x4 = _mm_set1_epi32(key);
+    size_t  k = 1;
+
+    while(8 * k + 7 <= size)
+    {
+      _prefetchNext(keys, size, k);
+
+      __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + 8 * k));
+      __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + 4 * k));
+
+      int r = _rankRun(keys, k, 1, key, upper) + _rankRun(keys, 2 * k, 2, key, upper);
+
+      if(upper)
+        r += 12 - __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, x8))))
+                - __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(c, x4))));
+      else
+        r += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(x8, a))))
+           + __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(x4, c))));
+
+      k = 16 * k + r;
+    }
+
+    return _finish(keys, size, k, key, upper);
+  }
+#endif
+
+  static BOUND _pick()
+  {
+#if defined(FROZEN_SIMD_X86)
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx2"))
+      return &_boundAvx2;
+
+    return &_boundSse2;
+#else
+    return &_boundScalar;
+#endif
+  }
+};
+
+template<>
+struct frozen_simd<long long> : frozen_simd_base<long long>
+{
+#if defined(FROZEN_SIMD_X86)
+  __attribute__((target("sse4.2")))
+  static size_t _boundSse42(const long long* keys, size_t size, long long key, bool upper)
+  {
+    __m128i x = _mm_set1_epi64x(key);
+    size_t  k = 1;
+
+    while(8 * k + 7 <= size)
+    {
+      _prefetchNext(keys, size, k);
+
+      int gt = 0;  // # of keys > key in the 4k and 8k runs
+      int lt = 0;  // # of keys < key in the 4k and 8k runs
+
+      for(size_t i = 0; i < 12; i += 2)  // 8k..8k+7, then 4k..4k+3
+      {
+        const long long* p = (i < 8) ? keys + 8 * k + i : keys + 4 * k + (i - 8);
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+
+        if(upper)
+          gt += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(v, x))));
+        else
+          lt += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(x, v))));
+      }
+
+      int r = _rankRun(keys, k, 1, key, upper) + _rankRun(keys, 2 * k, 2, key, upper);
+      k = 16 * k + r + (upper ? 12 - gt : lt);
+    }
+
+    return _finish(keys, size, k, key, upper);
+  }
+
+  __attribute__((target("avx2")))
+  static size_t _boundAvx2(const long long* keys, size_t size, long long key, bool upper)
+  {
+    __m256i x = _mm256_set1_epi64x(key);
+    size_t  k = 1;
+
+    while(8 * k + 7 <= size)
+    {
+      _prefetchNext(keys, size, k);
+
+      __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + 8 * k));
+      __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + 8 * k + 4));
+      __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + 4 * k));
+
+      int r = _rankRun(keys, k, 1, key, upper) + _rankRun(keys, 2 * k, 2, key, upper);
+
+      if(upper)
+        r += 12 - __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(a, x))))
+                - __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(b, x))))
+                - __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(c, x))));
+      else
+        r += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(x, a))))
+           + __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(x, b))))
+           + __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(x, c))));
+
+      k = 16 * k + r;
+    }
+
+    return _finish(keys, size, k, key, upper);
+  }
+#endif
+
+  static BOUND _pick()
+  {
+#if defined(FROZEN_SIMD_X86)
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx2"))
+      return &_boundAvx2;
+
+    if(__builtin_cpu_supports("sse4.2"))
+      return &_boundSse42;
+#endif
+    return &_boundScalar;
+  }
+};
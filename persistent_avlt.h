@@ -0,0 +1,778 @@
+/*persistent_avlt.h*/
+
+//
+// Persistent AVL tree: every update makes a new version in O(lgN),
+// sharing all untouched nodes with the old one.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//
+// persistent_avlt
+//
+// An immutable AVL tree.  insert() and erase() leave the tree they are
+// called on alone and return a new version: only the nodes on the path
+// from the root to the change are copied (plus the few a rotation
+// touches), everything else is shared with the old version.  Keeping
+// many versions around for point-in-time queries thus costs O(lgN)
+// time and memory per update instead of a full O(N) copy, and copying
+// a version is O(1).
+//
+// Nodes are reference counted: a node is freed when the last version
+// (or newer node) pointing to it goes away.  The counts are atomic, so
+// versions may be read, copied, updated and dropped on any number of
+// threads at once; only a single persistent_avlt object must not be
+// assigned to while another thread reads it, just like a shared_ptr.
+//
+// Unlike avlt, the nodes are not threaded.  A thread points at the
+// inorder successor, so every update would have to copy the nodes
+// threading to a copied node as well, which is not O(lgN).  Iterators
+// instead keep the path of ancestors still to be visited, so in-order
+// scans are still O(1) amortized per key and range queries on any
+// version are O(lgN + M).
+//
+template<typename KeyT, typename ValueT>
+class persistent_avlt
+{
+private:
+  struct NODE
+  {
+    KeyT        Key;
+    ValueT      Value;
+    const NODE* Left;
+    const NODE* Right;
+    int         Height;       // height of tree rooted at this node, leaf is 0
+    mutable atomic<int> Refs; // # of versions and nodes pointing here
+  };
+
+  // Largest height an AVL tree can reach while its size fits in an
+  // int, see avlt::MaxHeight
+  static const int MaxHeight = 43;
+
+  const NODE* Root;  // root of this version (nullptr if empty)
+  int         Size;  // # of nodes in this version
+
+
+	/* Height of a subtree, -1 if empty */
+	static int _height(const NODE* cur)
+	{
+		return (cur == nullptr) ? -1 : cur->Height;
+	}
+
+
+	/* Adds a reference to cur and returns it */
+	static const NODE* _retain(const NODE* cur)
+	{
+		if(cur != nullptr)
+			cur->Refs.fetch_add(1, memory_order_relaxed);
+
+		return cur;
+	}
+
+
+	/* Drops a reference to cur, freeing it and then
+	 * dropping its children once nobody uses it */
+	static void _release(const NODE* cur)
+	{
+		while(cur != nullptr && cur->Refs.fetch_sub(1, memory_order_acq_rel) == 1)
+		{
+			const NODE* right = cur->Right;
+
+			_release(cur->Left);
+			delete cur;
+
+			cur = right;  // Loop instead of recursing on one side
+		}
+	}
+
+
+	/* Makes a node over left and right, taking over
+	 * the references to them that the caller holds */
+	static const NODE* _node(const KeyT& key, const ValueT& value, const NODE* left,
+	                         const NODE* right)
+	{
+		try
+		{
+			return new NODE{key, value, left, right, 1 + max(_height(left), _height(right)), {1}};
+		}
+		catch(...)  // Out of memory or a copy threw, drop what we took over:
+		{
+			_release(left);
+			_release(right);
+			throw;
+		}
+	}
+
+
+	/* Makes a node over left and right, whose heights
+	 * differ by at most 2, rotating once or twice if
+	 * they differ by 2, like avlt::_rebalance does in
+	 * place.  Takes over the references to left and
+	 * right. */
+	static const NODE* _balance(const KeyT& key, const ValueT& value, const NODE* left,
+	                            const NODE* right)
+	{
+		int hL = _height(left);
+		int hR = _height(right);
+
+		if(hL > hR + 1)  // Left is leaning
+		{
+			const NODE* L = left;
+			const NODE* result;
+
+			try  // right is taken over first, so a throw only leaves L to drop
+			{
+				if(_height(L->Left) >= _height(L->Right))  // Rotate right
+				{
+					const NODE* top = _node(key, value, _retain(L->Right), right);
+					result = _node(L->Key, L->Value, _retain(L->Left), top);
+				}
+				else  // Rotate left at L, then right
+				{
+					const NODE* LR = L->Right;
+					const NODE* b = _node(key, value, _retain(LR->Right), right);
+					const NODE* a;
+
+					try
+					{
+						a = _node(L->Key, L->Value, _retain(L->Left), _retain(LR->Left));
+					}
+					catch(...)
+					{
+						_release(b);
+						throw;
+					}
+
+					result = _node(LR->Key, LR->Value, a, b);
+				}
+			}
+			catch(...)
+			{
+				_release(L);
+				throw;
+			}
+
+			_release(L);  // The parts still used were retained above
+			return result;
+		}
+
+		if(hR > hL + 1)  // Right is leaning
+		{
+			const NODE* R = right;
+			const NODE* result;
+
+			try  // left is taken over first, so a throw only leaves R to drop
+			{
+				if(_height(R->Right) >= _height(R->Left))  // Rotate left
+				{
+					const NODE* top = _node(key, value, left, _retain(R->Left));
+					result = _node(R->Key, R->Value, top, _retain(R->Right));
+				}
+				else  // Rotate right at R, then left
+				{
+					const NODE* RL = R->Left;
+					const NODE* a = _node(key, value, left, _retain(RL->Left));
+					const NODE* b;
+
+					try
+					{
+						b = _node(R->Key, R->Value, _retain(RL->Right), _retain(R->Right));
+					}
+					catch(...)
+					{
+						_release(a);
+						throw;
+					}
+
+					result = _node(RL->Key, RL->Value, a, b);
+				}
+			}
+			catch(...)
+			{
+				_release(R);
+				throw;
+			}
+
+			_release(R);
+			return result;
+		}
+
+		return _node(key, value, left, right);
+	}
+
+
+	/* Returns a new version of the subtree at cur with
+	 * key inserted, copying the path down to it; sets
+	 * added to false and returns nullptr, copying
+	 * nothing, if key is already there */
+	static const NODE* _insert(const NODE* cur, const KeyT& key, const ValueT& value, bool& added)
+	{
+		if(cur == nullptr)  // Fell out of the tree, key is new
+		{
+			added = true;
+			return _node(key, value, nullptr, nullptr);
+		}
+
+		if(key == cur->Key)  // Already there, nothing changes
+		{
+			added = false;
+			return nullptr;
+		}
+
+		if(key < cur->Key)
+		{
+			const NODE* left = _insert(cur->Left, key, value, added);
+			if(!added)
+				return nullptr;
+
+			return _balance(cur->Key, cur->Value, left, _retain(cur->Right));
+		}
+		else
+		{
+			const NODE* right = _insert(cur->Right, key, value, added);
+			if(!added)
+				return nullptr;
+
+			return _balance(cur->Key, cur->Value, _retain(cur->Left), right);
+		}
+	}
+
+
+	/* Returns a new version of the subtree at cur
+	 * without its smallest node, whose key and value
+	 * are handed back through min */
+	static const NODE* _eraseMin(const NODE* cur, const NODE*& min)
+	{
+		if(cur->Left == nullptr)  // cur is the smallest, its right subtree moves up
+		{
+			min = cur;
+			return _retain(cur->Right);
+		}
+
+		const NODE* left = _eraseMin(cur->Left, min);
+		return _balance(cur->Key, cur->Value, left, _retain(cur->Right));
+	}
+
+
+	/* Returns a new version of the subtree at cur with
+	 * key erased, copying the path down to it; sets
+	 * found to false and returns nullptr, copying
+	 * nothing, if key is not there */
+	static const NODE* _erase(const NODE* cur, const KeyT& key, bool& found)
+	{
+		if(cur == nullptr)  // Not in the tree
+		{
+			found = false;
+			return nullptr;
+		}
+
+		if(key == cur->Key)  // Found, splice it out
+		{
+			found = true;
+
+			if(cur->Left == nullptr)
+				return _retain(cur->Right);
+
+			if(cur->Right == nullptr)
+				return _retain(cur->Left);
+
+			/* Two children: the successor takes its place */
+			const NODE* succ;
+			const NODE* right = _eraseMin(cur->Right, succ);
+
+			return _balance(succ->Key, succ->Value, _retain(cur->Left), right);
+		}
+
+		if(key < cur->Key)
+		{
+			const NODE* left = _erase(cur->Left, key, found);
+			if(!found)
+				return nullptr;
+
+			return _balance(cur->Key, cur->Value, left, _retain(cur->Right));
+		}
+		else
+		{
+			const NODE* right = _erase(cur->Right, key, found);
+			if(!found)
+				return nullptr;
+
+			return _balance(cur->Key, cur->Value, _retain(cur->Left), right);
+		}
+	}
+
+
+	/* Builds a perfectly balanced tree over the sorted,
+	 * distinct pairs [first, first + n) */
+	template<typename Pair>
+	static const NODE* _build(const Pair* first, int n)
+	{
+		if(n == 0)
+			return nullptr;
+
+		int mid = n / 2;
+		const NODE* left = _build(first, mid);
+		const NODE* right;
+
+		try
+		{
+			right = _build(first + mid + 1, n - mid - 1);
+		}
+		catch(...)
+		{
+			_release(left);
+			throw;
+		}
+
+		return _node(first[mid].first, first[mid].second, left, right);
+	}
+
+
+	/* Returns the node that contains key,
+	 * or nullptr if key is not in the tree */
+	const NODE* _find(const KeyT& key) const
+	{
+		const NODE* cur = Root;
+
+		while(cur != nullptr)
+		{
+			if(key == cur->Key)  // Key found
+				return cur;
+
+			cur = (key < cur->Key) ? cur->Left : cur->Right;
+		}
+
+		return nullptr;
+	}
+
+
+	/* Version over root, which the caller's
+	 * reference to is taken over */
+	persistent_avlt(const NODE* root, int size)
+	  : Root(root), Size(size)
+	{ }
+
+public:
+  //
+  // default constructor:
+  //
+  // Creates an empty tree.
+  //
+  persistent_avlt()
+    : Root(nullptr), Size(0)
+  { }
+
+  //
+  // range constructor:
+  //
+  // Builds a perfectly balanced version from a range of (key, value)
+  // pairs, like avlt's range constructor: of equal keys only the first
+  // is kept, and an unsorted range is sorted first.
+  //
+  // Time complexity:  O(N) for sorted input, O(NlgN) otherwise
+  //
+  template<typename InputIt>
+  persistent_avlt(InputIt first, InputIt last)
+    : Root(nullptr), Size(0)
+  {
+    vector<pair<KeyT, ValueT>> pairs;
+    for(; first != last; ++first)
+      pairs.push_back(make_pair((*first).first, (*first).second));
+
+    auto less = [](const pair<KeyT, ValueT>& a, const pair<KeyT, ValueT>& b)
+    {
+      return a.first < b.first;
+    };
+
+    if(!is_sorted(pairs.begin(), pairs.end(), less))
+      stable_sort(pairs.begin(), pairs.end(), less);
+
+    pairs.erase(unique(pairs.begin(), pairs.end(),
+                       [](const pair<KeyT, ValueT>& a, const pair<KeyT, ValueT>& b)
+                       {
+                         return a.first == b.first;
+                       }),
+                pairs.end());
+
+    Root = _build(pairs.data(), (int)pairs.size());
+    Size = (int)pairs.size();
+  }
+
+  //
+  // copy constructor / operator=:
+  //
+  // Another handle on the same version; nothing is copied.
+  //
+  // Time complexity:  O(1)
+  //
+  persistent_avlt(const persistent_avlt& other)
+    : Root(_retain(other.Root)), Size(other.Size)
+  { }
+
+  persistent_avlt& operator=(const persistent_avlt& other)
+  {
+    const NODE* old = Root;
+
+    Root = _retain(other.Root);
+    Size = other.Size;
+    _release(old);  // After the retain, in case other is this
+
+    return *this;
+  }
+
+  //
+  // move constructor / move operator=:
+  //
+  // Takes over other's version, leaving other empty.
+  //
+  persistent_avlt(persistent_avlt&& other) noexcept
+    : Root(other.Root), Size(other.Size)
+  {
+    other.Root = nullptr;
+    other.Size = 0;
+  }
+
+  persistent_avlt& operator=(persistent_avlt&& other) noexcept
+  {
+    if(this != &other)
+    {
+      _release(Root);
+      Root = other.Root;
+      Size = other.Size;
+      other.Root = nullptr;
+      other.Size = 0;
+    }
+
+    return *this;
+  }
+
+  //
+  // destructor:
+  //
+  // Drops this handle; nodes no other version shares are freed.
+  //
+  ~persistent_avlt()
+  {
+    _release(Root);
+  }
+
+  //
+  // size:
+  //
+  // Returns the # of nodes in this version, 0 if empty.
+  //
+  // Time complexity:  O(1)
+  //
+  int size() const
+  {
+    return Size;
+  }
+
+  //
+  // height:
+  //
+  // Returns the height of this version, -1 if empty.
+  //
+  // Time complexity:  O(1)
+  //
+  int height() const
+  {
+    return _height(Root);
+  }
+
+  //
+  // insert:
+  //
+  // Returns a new version with key inserted; this version does not
+  // change.  If key is already present, the new version is this one
+  // (and nothing is copied), just as avlt::insert leaves the tree alone.
+  //
+  // Example:
+  //    persistent_avlt<int, int> v1;
+  //    persistent_avlt<int, int> v2 = v1.insert(10, 100);  // v1 is still empty
+  //
+  // Time complexity:  O(lgN), copying O(lgN) nodes
+  //
+  [[nodiscard]] persistent_avlt insert(const KeyT& key, const ValueT& value) const
+  {
+    bool added = false;
+    const NODE* root = _insert(Root, key, value, added);
+
+    if(!added)
+      return *this;
+
+    return persistent_avlt(root, Size + 1);
+  }
+
+  //
+  // erase:
+  //
+  // Returns a new version without key; this version does not change.
+  // If key is not present, the new version is this one.
+  //
+  // Time complexity:  O(lgN), copying O(lgN) nodes
+  //
+  [[nodiscard]] persistent_avlt erase(const KeyT& key) const
+  {
+    bool found = false;
+    const NODE* root = _erase(Root, key, found);
+
+    if(!found)
+      return *this;
+
+    return persistent_avlt(root, Size - 1);
+  }
+
+  //
+  // search:
+  //
+  // Searches this version for the given key, returning true and the
+  // value if found, false if not.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    const NODE* cur = _find(key);
+
+    if(cur == nullptr)  // Not found
+      return false;
+
+    value = cur->Value;
+    return true;
+  }
+
+  //
+  // []
+  //
+  // Returns the value for the given key; if the key is not found,
+  // the default value ValueT{} is returned.
+  //
+  // Time complexity:  O(lgN) worst-case
+  //
+  ValueT operator[](const KeyT& key) const
+  {
+    const NODE* cur = _find(key);
+
+    return (cur == nullptr) ? ValueT{ } : cur->Value;
+  }
+
+  //
+  // const_iterator
+  //
+  // Forward iterator over the (key, value) pairs of one version in key
+  // order; the same interface as avlt::const_iterator.  It holds the
+  // ancestors still to be visited, so it stays valid for as long as
+  // the version it came from (or any version sharing the nodes) lives.
+  //
+  class const_iterator
+  {
+  private:
+    friend class persistent_avlt;
+
+    const NODE* Stack[MaxHeight + 1];  // current node on top, then the
+    int         Top;                   // ancestors whose keys come next
+
+    /* Pushes cur and its left spine */
+    void _descend(const NODE* cur)
+    {
+      for(; cur != nullptr; cur = cur->Left)
+        Stack[Top++] = cur;
+    }
+
+  public:
+    using iterator_category = forward_iterator_tag;
+    using value_type        = pair<KeyT, ValueT>;
+    using difference_type   = ptrdiff_t;
+    using reference         = pair<const KeyT&, const ValueT&>;
+    using pointer           = void;
+
+    const_iterator() : Top(0) { }
+
+    const KeyT& key() const
+    {
+      return Stack[Top - 1]->Key;
+    }
+
+    const ValueT& value() const
+    {
+      return Stack[Top - 1]->Value;
+    }
+
+    reference operator*() const
+    {
+      return reference(key(), value());
+    }
+
+    const_iterator& operator++()
+    {
+      const NODE* cur = Stack[--Top];
+      _descend(cur->Right);  // Successor is leftmost on the right
+      return *this;
+    }
+
+    const_iterator operator++(int)
+    {
+      const_iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    bool operator==(const const_iterator& other) const
+    {
+      if(Top == 0 || other.Top == 0)
+        return Top == other.Top;
+
+      return Stack[Top - 1] == other.Stack[other.Top - 1];
+    }
+
+    bool operator!=(const const_iterator& other) const
+    {
+      return !(*this == other);
+    }
+  };
+
+  //
+  // cbegin / cend / begin / end:
+  //
+  // Iterators to the smallest pair and one past the largest.
+  //
+  // Time complexity:  O(lgN) for cbegin, O(1) for cend
+  //
+  const_iterator cbegin() const
+  {
+    const_iterator it;
+    it._descend(Root);
+    return it;
+  }
+
+  const_iterator cend() const
+  {
+    return const_iterator();
+  }
+
+  const_iterator begin() const
+  {
+    return cbegin();
+  }
+
+  const_iterator end() const
+  {
+    return cend();
+  }
+
+  //
+  // find / lower_bound / upper_bound
+  //
+  // Same as avlt: iterator to the key, to the first key not less than
+  // it, or to the first key greater than it; cend() if there is none.
+  //
+  // Time complexity:  O(lgN)
+  //
+  const_iterator find(const KeyT& key) const
+  {
+    const_iterator it = lower_bound(key);
+
+    if(it != cend() && key < it.key())  // Not found
+      return cend();
+
+    return it;
+  }
+
+  const_iterator lower_bound(const KeyT& key) const
+  {
+    const_iterator it;
+
+    /* Keep the nodes we go left at, they come after key */
+    for(const NODE* cur = Root; cur != nullptr; )
+    {
+      if(!(cur->Key < key))
+      {
+        it.Stack[it.Top++] = cur;
+        cur = cur->Left;
+      }
+      else
+        cur = cur->Right;
+    }
+
+    return it;
+  }
+
+  const_iterator upper_bound(const KeyT& key) const
+  {
+    const_iterator it;
+
+    for(const NODE* cur = Root; cur != nullptr; )
+    {
+      if(key < cur->Key)
+      {
+        it.Stack[it.Top++] = cur;
+        cur = cur->Left;
+      }
+      else
+        cur = cur->Right;
+    }
+
+    return it;
+  }
+
+  //
+  // range_for_each
+  //
+  // Same as avlt::range_for_each: calls visit(key, value) for every pair
+  // in [lower..upper], in order; a visitor returning false stops the
+  // scan.  Returns the # of pairs visited.
+  //
+  // Time complexity:  O(lgN + M), where M is the # of pairs visited
+  //
+  template<typename Visitor>
+  size_t range_for_each(const KeyT& lower, const KeyT& upper, Visitor visit) const
+  {
+    size_t count = 0;
+
+    if(upper < lower)  // Invalid bounds
+      return 0;
+
+    for(const_iterator it = lower_bound(lower); it != cend() && !(upper < it.key()); ++it)
+    {
+      count++;
+
+      if constexpr (is_void<decltype(visit(it.key(), it.value()))>::value)
+        visit(it.key(), it.value());
+      else if(!visit(it.key(), it.value()))
+        break;
+    }
+
+    return count;
+  }
+
+  //
+  // range_search
+  //
+  // Same as avlt::range_search: every key in [lower..upper], inclusive,
+  // in order.
+  //
+  // Time complexity:  O(lgN + M)
+  //
+  vector<KeyT> range_search(const KeyT& lower, const KeyT& upper) const
+  {
+    vector<KeyT> keys;
+
+    range_for_each(lower, upper, [&](const KeyT& key, const ValueT&)
+    {
+      keys.push_back(key);
+    });
+
+    return keys;
+  }
+};
@@ -0,0 +1,514 @@
+/*sharded_avlt.h*/
+
+//
+// Key-range sharded threaded AVL trees.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "avlt.h"
+
+using namespace std;
+
+//
+// sharded_avlt
+//
+// Splits the key space into contiguous ranges, one avlt per range, and
+// routes every operation to the shard that owns its key.  Shard i holds
+// the keys in [Bounds[i-1], Bounds[i]), so in-order iteration and range
+// scans just walk the shards left to right.  Boundaries are chosen from
+// a sample of keys (set_boundaries), ideally one shard per core, so
+// each shard can be filled by its own worker (insert_parallel) and the
+// trees stay shallow and independent.
+//
+// Stats and Compare are the same policies as avlt's and are passed on
+// to every shard; the boundaries are ordered, and keys routed, with the
+// same Compare.
+//
+// Like avlt, a sharded_avlt is not synchronized: any number of threads
+// may read a const sharded_avlt, but updates need exclusive access.
+// insert_parallel does its own threading internally.  An update only
+// touches the shard that owns its key, so updates to different shards
+// may run at once; concurrent_avlt locks each shard on its own.
+//
+template<typename KeyT, typename ValueT, template<typename> class NodeAlloc = avlt_pool,
+         bool OrderStats = false, typename Stats = avlt_no_stats,
+         typename Compare = avlt_compare>
+class sharded_avlt : private Compare
+{
+public:
+  typedef avlt<KeyT, ValueT, NodeAlloc, OrderStats, Stats, Compare> tree_type;
+
+private:
+  vector<tree_type> Shards;  // one tree per key range, in key order
+  vector<KeyT>      Bounds;  // Bounds[i] is the smallest key of shard i+1
+
+
+	/* true if a comes before b under Compare */
+	bool _less(const KeyT& a, const KeyT& b) const
+	{
+		return avlt_less(static_cast<const Compare&>(*this), a, b);
+	}
+
+
+	/* Replaces the shards with n empty trees,
+	 * each one ordered by this tree's Compare */
+	void _reset(size_t n)
+	{
+		const Compare& compare = *this;
+
+		Shards.clear();
+		Shards.reserve(n);
+
+		for(size_t i = 0; i < n; i++)
+			Shards.emplace_back(compare);
+	}
+
+
+	/* Returns the index of the shard that owns key, the
+	 * # of bounds not after it.  The range is halved by
+	 * picking a pointer, not by a branch: keys spread
+	 * over the shards make that branch a coin toss. */
+	int _shard(const KeyT& key) const
+	{
+		const KeyT* base = Bounds.data();
+		size_t      n = Bounds.size();
+
+		while(n > 1)
+		{
+			size_t half = n / 2;
+			base = _less(key, base[half]) ? base : base + half;
+			n -= half;
+		}
+
+		return (int)(base - Bounds.data()) + (n == 1 && !_less(key, *base));
+	}
+
+public:
+  //
+  // const_iterator
+  //
+  // Forward iterator over every (key, value) pair in inorder, moving
+  // from one shard to the next at the boundaries.
+  //
+  class const_iterator
+  {
+  private:
+    friend class sharded_avlt;
+
+    const sharded_avlt*                  Owner;  // tree being walked
+    int                                  Shard;  // shard of the current pair
+    typename tree_type::const_iterator   It;     // position inside that shard
+
+    const_iterator(const sharded_avlt* owner, int shard, typename tree_type::const_iterator it)
+      : Owner(owner), Shard(shard), It(it)
+    {
+      _skipEmpty();
+    }
+
+    /* Moves to the first pair of the next non-empty shard
+     * whenever the current shard is used up */
+    void _skipEmpty()
+    {
+      while(It == Owner->Shards[Shard].cend() && Shard + 1 < (int)Owner->Shards.size())
+      {
+        Shard++;
+        It = Owner->Shards[Shard].cbegin();
+      }
+    }
+
+  public:
+    using iterator_category = forward_iterator_tag;
+    using value_type        = typename tree_type::const_iterator::value_type;
+    using difference_type   = ptrdiff_t;
+    using reference         = typename tree_type::const_iterator::reference;
+    using pointer           = void;
+
+    const_iterator() : Owner(nullptr), Shard(0), It() { }
+
+    const KeyT& key() const
+    {
+      return It.key();
+    }
+
+    const ValueT& value() const
+    {
+      return It.value();
+    }
+
+    reference operator*() const
+    {
+      return *It;
+    }
+
+    const_iterator& operator++()
+    {
+      ++It;
+      _skipEmpty();
+      return *this;
+    }
+
+    const_iterator operator++(int)
+    {
+      const_iterator old = *this;
+      ++(*this);
+      return old;
+    }
+
+    bool operator==(const const_iterator& other) const
+    {
+      return It == other.It;
+    }
+
+    bool operator!=(const const_iterator& other) const
+    {
+      return It != other.It;
+    }
+  };
+
+  //
+  // default constructor:
+  //
+  // Creates an empty tree with a single shard; call set_boundaries to
+  // split it.
+  //
+  explicit sharded_avlt(const Compare& compare = Compare())
+    : Compare(compare)
+  {
+    _reset(1);
+  }
+
+  //
+  // constructor:
+  //
+  // Creates an empty tree whose shard boundaries are picked from a
+  // sample of keys; see set_boundaries.
+  //
+  sharded_avlt(vector<KeyT> samples, int shards = (int)thread::hardware_concurrency(),
+               const Compare& compare = Compare())
+    : Compare(compare)
+  {
+    _reset(1);
+    set_boundaries(std::move(samples), shards);
+  }
+
+  //
+  // set_boundaries:
+  //
+  // Picks the boundaries of up to "shards" shards so that each one gets
+  // an equal share of the sample keys, then moves every pair already in
+  // the tree to its new shard.  Duplicate sample keys can leave fewer
+  // shards than asked for.
+  //
+  // Time complexity:  O(S lgS + N), S = # of samples
+  //
+  void set_boundaries(vector<KeyT> samples, int shards)
+  {
+    sort(samples.begin(), samples.end(),
+         [this](const KeyT& a, const KeyT& b) { return _less(a, b); });
+
+    vector<KeyT> bounds;
+    for(int i = 1; i < shards && !samples.empty(); i++)
+    {
+      const KeyT& bound = samples[(size_t)i * samples.size() / shards];
+
+      /* Skip repeats so no shard has an empty key range */
+      if(bounds.empty() || _less(bounds.back(), bound))
+        bounds.push_back(bound);
+    }
+
+    /* Pull out every pair in order, then rebuild the shards */
+    vector<pair<KeyT, ValueT>> pairs;
+    pairs.reserve(size());
+
+    for(const_iterator it = cbegin(); it != cend(); ++it)
+      pairs.push_back(pair<KeyT, ValueT>(it.key(), it.value()));
+
+    Bounds = std::move(bounds);
+    _reset(Bounds.size() + 1);
+
+    auto first = pairs.begin();
+    for(size_t i = 0; i < Shards.size(); i++)
+    {
+      auto last = (i < Bounds.size())
+        ? lower_bound(first, pairs.end(), Bounds[i],
+            [this](const pair<KeyT, ValueT>& kv, const KeyT& key) { return _less(kv.first, key); })
+        : pairs.end();
+
+      Shards[i].assign_sorted(first, last);
+      first = last;
+    }
+  }
+
+  //
+  // shard_count / shard:
+  //
+  // The # of shards and access to each one.  Only keys that shard_of
+  // maps to i may be put into shard i.
+  //
+  int shard_count() const
+  {
+    return (int)Shards.size();
+  }
+
+  const tree_type& shard(int i) const
+  {
+    return Shards[i];
+  }
+
+  tree_type& shard(int i)
+  {
+    return Shards[i];
+  }
+
+  //
+  // shard_of:
+  //
+  // Returns the index of the shard that owns key.
+  //
+  // Time complexity:  O(lg(# of shards))
+  //
+  int shard_of(const KeyT& key) const
+  {
+    return _shard(key);
+  }
+
+  //
+  // clear:
+  //
+  // Empties every shard, keeping the boundaries.
+  //
+  void clear()
+  {
+    for(tree_type& t : Shards)
+      t.clear();
+  }
+
+  //
+  // size:
+  //
+  // Returns the # of pairs in all shards.
+  //
+  // Time complexity:  O(# of shards)
+  //
+  int size() const
+  {
+    int n = 0;
+
+    for(const tree_type& t : Shards)
+      n += t.size();
+
+    return n;
+  }
+
+  //
+  // height:
+  //
+  // Returns the height of the tallest shard, -1 if empty.
+  //
+  // Time complexity:  O(# of shards)
+  //
+  int height() const
+  {
+    int h = -1;
+
+    for(const tree_type& t : Shards)
+      h = max(h, t.height());
+
+    return h;
+  }
+
+  //
+  // insert / erase / search / operator[] / operator%:
+  //
+  // Same as avlt, on the shard that owns the key.
+  //
+  // Time complexity:  O(lg(# of shards) + lg(shard size))
+  //
+  void insert(const KeyT& key, const ValueT& value)
+  {
+    Shards[_shard(key)].insert(key, value);
+  }
+
+  bool erase(const KeyT& key)
+  {
+    return Shards[_shard(key)].erase(key);
+  }
+
+  bool search(const KeyT& key, ValueT& value) const
+  {
+    return Shards[_shard(key)].search(key, value);
+  }
+
+  ValueT operator[](const KeyT& key) const
+  {
+    return Shards[_shard(key)][key];
+  }
+
+  int operator%(const KeyT& key) const
+  {
+    return Shards[_shard(key)] % key;
+  }
+
+  //
+  // ()
+  //
+  // Same as avlt: the key to the "right" of the given key.  For the
+  // last key of a shard, whose thread ends the shard, that is the first
+  // key of the next non-empty shard.
+  //
+  KeyT operator()(const KeyT& key) const
+  {
+    int i = _shard(key);
+    auto it = Shards[i].find(key);
+
+    if(it == Shards[i].cend())  // Key not found
+      return KeyT{ };
+
+    if(++it != Shards[i].cend())  // Not the last key, ask the shard
+      return Shards[i](key);
+
+    /* Last key of the shard, continue in the next shard */
+    const_iterator next(this, i, it);
+    return (next == cend()) ? KeyT{ } : next.key();
+  }
+
+  //
+  // range_search
+  //
+  // Same as avlt: every key in [lower..upper], inclusive, in order,
+  // collected from each shard the range overlaps.
+  //
+  // Time complexity: O(# of shards + lgN + M)
+  //
+  vector<KeyT> range_search(const KeyT& lower, const KeyT& upper) const
+  {
+    vector<KeyT> keys;
+
+    range_for_each(lower, upper, [&](const KeyT& key, const ValueT&)
+    {
+      keys.push_back(key);
+    });
+
+    return keys;
+  }
+
+  //
+  // range_for_each
+  //
+  // Same as avlt::range_for_each, across shard boundaries; a visitor
+  // returning false stops the whole scan.  Returns the # of pairs
+  // visited.
+  //
+  template<typename Visitor>
+  size_t range_for_each(const KeyT& lower, const KeyT& upper, Visitor visit) const
+  {
+    size_t count = 0;
+    bool   stopped = false;
+
+    if(_less(upper, lower))  // Invalid bounds
+      return 0;
+
+    for(int i = _shard(lower); i <= _shard(upper) && !stopped; i++)
+    {
+      count += Shards[i].range_for_each(lower, upper, [&](const KeyT& key, const ValueT& value)
+      {
+        if constexpr (is_void<decltype(visit(key, value))>::value)
+          visit(key, value);
+        else
+          stopped = !visit(key, value);
+
+        return !stopped;
+      });
+    }
+
+    return count;
+  }
+
+  //
+  // insert_parallel:
+  //
+  // Inserts every (key, value) pair in [first, last), a random access
+  // range, with one worker thread per shard (at most "threads" at a
+  // time).  The pairs are first bucketed by shard, so every worker
+  // only ever touches its own tree.
+  //
+  // Time complexity:  O(M + M lgN / threads)
+  //
+  template<typename RandomIt>
+  void insert_parallel(RandomIt first, RandomIt last,
+                       int threads = (int)thread::hardware_concurrency())
+  {
+    size_t n = last - first;
+    int    shards = (int)Shards.size();
+
+    /* Bucket the positions of the pairs by shard */
+    vector<vector<size_t>> buckets(shards);
+    for(size_t i = 0; i < n; i++)
+      buckets[_shard(first[i].first)].push_back(i);
+
+    int workers = max(1, min(threads, shards));
+    vector<thread> pool;
+    vector<exception_ptr> errors(workers);
+
+    auto work = [&](int w)
+    {
+      try
+      {
+        for(int s = w; s < shards; s += workers)
+        {
+          for(size_t i : buckets[s])
+            Shards[s].insert(first[i].first, first[i].second);
+        }
+      }
+      catch(...)
+      {
+        errors[w] = current_exception();
+      }
+    };
+
+    for(int w = 1; w < workers; w++)
+      pool.push_back(thread(work, w));
+
+    work(0);  // The calling thread is worker 0
+
+    for(thread& t : pool)
+      t.join();
+
+    for(exception_ptr& error : errors)
+    {
+      if(error)
+        rethrow_exception(error);
+    }
+  }
+
+  //
+  // cbegin / cend / begin / end:
+  //
+  // Iterators over every pair in inorder, across all shards.
+  //
+  const_iterator cbegin() const
+  {
+    return const_iterator(this, 0, Shards[0].cbegin());
+  }
+
+  const_iterator cend() const
+  {
+    return const_iterator(this, (int)Shards.size() - 1, Shards.back().cend());
+  }
+
+  const_iterator begin() const
+  {
+    return cbegin();
+  }
+
+  const_iterator end() const
+  {
+    return cend();
+  }
+};
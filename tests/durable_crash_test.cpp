@@ -0,0 +1,330 @@
+/*durable_crash_test.cpp*/
+
+//
+// Crash injection for durable_avlt.  A child process runs updates and
+// records in shared memory how many have returned (been acknowledged);
+// the parent kills it with SIGKILL at a random moment, reopens the
+// directory, and checks that recovery gives back exactly the updates
+// of some prefix that holds every acknowledged one.  Three cases:
+//
+//   group commit   several threads, syncEvery == 1, killed while
+//                  their records share fsyncs
+//   checkpoint     a tiny checkpointBytes, so most kills land while a
+//                  checkpoint is being written, renamed or the journal
+//                  truncated
+//   torn states    the files a kill can leave behind, built directly:
+//                  the journal cut at every byte, and a checkpoint
+//                  left half written, written but not renamed, or
+//                  renamed with the journal not yet emptied
+//
+// Exits with status 1 at the first failure.
+//
+// Build: g++ -std=c++17 -O2 -pthread -I.. durable_crash_test.cpp -o durable_crash_test
+// Usage: ./durable_crash_test [directory] [kills]
+//
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "durable_avlt.h"
+
+using namespace std;
+
+typedef durable_avlt<int, int> tree_type;
+
+static string Dir;
+
+/* Reports a failed check and stops */
+static void check(bool ok, const string& what)
+{
+  if(!ok)
+  {
+    cerr << "FAILED: " << what << endl;
+    exit(1);
+  }
+}
+
+/* Removes the directory and every file durable_avlt puts in it */
+static void wipe()
+{
+  for(const char* name : {"journal", "checkpoint", "checkpoint.tmp",
+                          "checkpoint.new", "checkpoint.new.tmp"})
+    remove((Dir + "/" + name).c_str());
+
+  rmdir(Dir.c_str());
+}
+
+/* Update # j of the single-writer sequence: mostly inserts, and every
+ * fourth an erase of a key inserted two updates before, so every
+ * update changes the tree and is journaled */
+static void apply(int j, tree_type& tree)
+{
+  if(j % 4 == 3)
+    tree.erase(j - 2);
+  else
+    tree.insert(j, j * 7);
+}
+
+/* The contents after the first n updates of that sequence */
+static map<int, int> expected(int n)
+{
+  map<int, int> pairs;
+
+  for(int j = 0; j < n; j++)
+  {
+    if(j % 4 == 3)
+      pairs.erase(j - 2);
+    else
+      pairs[j] = j * 7;
+  }
+
+  return pairs;
+}
+
+/* true if the tree holds exactly the given pairs */
+static bool same(const tree_type& tree, const map<int, int>& pairs)
+{
+  if(tree.size() != (int)pairs.size())
+    return false;
+
+  for(auto& kv : pairs)
+  {
+    int value;
+    if(!tree.search(kv.first, value) || value != kv.second)
+      return false;
+  }
+
+  return true;
+}
+
+/* Runs child() in a new process, kills it after a random delay, and
+ * returns once it is gone */
+template<typename Child>
+static void crash(mt19937& rng, int maxMicros, Child child)
+{
+  pid_t pid = fork();
+  check(pid >= 0, "fork");
+
+  if(pid == 0)
+  {
+    child();
+    _exit(0);
+  }
+
+  usleep(1000 + rng() % maxMicros);
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+}
+
+/* Threads each insert their own run of keys with syncEvery == 1 */
+static void groupCommit(mt19937& rng, int kills)
+{
+  const int Threads = 4;
+  const int Run = 1 << 20;  // keys of thread t start at t * Run
+
+  atomic<long>* acked = (atomic<long>*)mmap(nullptr, Threads * sizeof(atomic<long>),
+                                            PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  check(acked != MAP_FAILED, "mmap");
+
+  for(int k = 0; k < kills; k++)
+  {
+    wipe();
+    for(int t = 0; t < Threads; t++)
+      new (&acked[t]) atomic<long>(0);
+
+    crash(rng, 50000, [&]()
+    {
+      tree_type tree(Dir, 1);
+      vector<thread> pool;
+
+      for(int t = 0; t < Threads; t++)
+        pool.emplace_back([&, t]()
+        {
+          for(int i = 0; i < Run; i++)
+          {
+            tree.insert(t * Run + i, i);
+            acked[t].store(i + 1);
+          }
+        });
+
+      for(thread& th : pool)
+        th.join();
+    });
+
+    tree_type tree(Dir);
+    int total = 0;
+
+    for(int t = 0; t < Threads; t++)
+    {
+      long n = acked[t].load();
+      int  value;
+
+      /* At most the one update the thread was in can be extra */
+      check(n == 0 || (tree.search(t * Run + (int)n - 1, value) && value == n - 1),
+            "group commit: acknowledged insert lost");
+
+      long have = n;
+      if(tree.search(t * Run + (int)n, value))
+        have++;
+
+      for(long i = 0; i < have; i++)
+        check(tree.search(t * Run + (int)i, value) && value == i,
+              "group commit: recovered inserts are not a prefix");
+
+      total += (int)have;
+    }
+
+    check(tree.size() == total, "group commit: recovered a key never inserted");
+  }
+
+  munmap(acked, Threads * sizeof(atomic<long>));
+  cout << "group commit: " << kills << " kills ok" << endl;
+}
+
+/* One writer with a checkpoint every few records */
+static void checkpoints(mt19937& rng, int kills)
+{
+  atomic<long>* acked = (atomic<long>*)mmap(nullptr, sizeof(atomic<long>), PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  check(acked != MAP_FAILED, "mmap");
+
+  for(int k = 0; k < kills; k++)
+  {
+    wipe();
+    new (acked) atomic<long>(0);
+
+    crash(rng, 50000, [&]()
+    {
+      tree_type tree(Dir, 1, 256);
+
+      for(int j = 0; ; j++)
+      {
+        apply(j, tree);
+        acked->store(j + 1);
+      }
+    });
+
+    int n = (int)acked->load();
+    tree_type tree(Dir);
+
+    check(same(tree, expected(n)) || same(tree, expected(n + 1)),
+          "checkpoint: recovered state is not a prefix holding every acknowledged update");
+  }
+
+  munmap(acked, sizeof(atomic<long>));
+  cout << "checkpoint: " << kills << " kills ok" << endl;
+}
+
+/* Builds each state a crash can leave on disk and recovers from it */
+static void tornStates()
+{
+  const int Saved = 50;  // updates in the checkpoint
+  const int Total = 90;  // updates in all
+
+  /* A checkpoint of the first Saved updates, and a journal of the rest */
+  wipe();
+  {
+    tree_type tree(Dir, 1, (size_t)1 << 30);
+
+    for(int j = 0; j < Saved; j++)
+      apply(j, tree);
+
+    tree.checkpoint();
+
+    for(int j = Saved; j < Total; j++)
+      apply(j, tree);
+  }
+
+  string   journal = Dir + "/journal";
+  ifstream in(journal, ios::binary);
+  string   bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+  in.close();
+
+  auto restore = [&](size_t length)
+  {
+    ofstream out(journal, ios::binary | ios::trunc);
+    out.write(bytes.data(), (streamsize)length);
+  };
+
+  /* The journal cut at every byte: recovery must stop at the last
+   * whole record, never going back */
+  int last = Saved;
+  for(size_t cut = 0; cut <= bytes.size(); cut++)
+  {
+    restore(cut);
+
+    tree_type tree(Dir);
+    int n = last;
+
+    while(n <= Total && !same(tree, expected(n)))
+      n++;
+
+    check(n <= Total, "torn journal: cut at byte " + to_string(cut) + " is not a prefix");
+    last = n;
+  }
+
+  check(last == Total, "torn journal: whole journal not replayed");
+
+  /* A checkpoint of all the updates, as the next checkpoint would write it */
+  avlt<int, int> all;
+  for(auto& kv : expected(Total))
+    all.insert(kv.first, kv.second);
+
+  string newer = Dir + "/checkpoint.new";
+
+  /* Killed while writing the new image: a partial temporary file */
+  restore(bytes.size());
+  all.save(newer);
+  rename(newer.c_str(), (newer + ".tmp").c_str());
+  check(truncate((newer + ".tmp").c_str(), 40) == 0, "truncate");
+  {
+    tree_type tree(Dir);
+    check(same(tree, expected(Total)), "checkpoint half written: updates lost");
+  }
+
+  /* Killed before the rename: a whole new image next to the old one */
+  remove((newer + ".tmp").c_str());
+  restore(bytes.size());
+  all.save(newer);
+  {
+    tree_type tree(Dir);
+    check(same(tree, expected(Total)), "checkpoint not renamed: updates lost");
+  }
+
+  /* Killed after the rename: the new image, the journal not emptied */
+  restore(bytes.size());
+  all.save(Dir + "/checkpoint");
+  remove(newer.c_str());
+  {
+    tree_type tree(Dir);
+    check(same(tree, expected(Total)), "journal not emptied: replay changed the tree");
+  }
+
+  cout << "torn states: " << bytes.size() + 1 << " cuts ok" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  Dir = (argc > 1) ? argv[1] : "durable_crash_test.dir";
+  int kills = (argc > 2) ? atoi(argv[2]) : 25;
+
+  mt19937 rng(251);
+
+  tornStates();
+  groupCommit(rng, kills);
+  checkpoints(rng, kills);
+
+  wipe();
+  return 0;
+}